@@ -67,10 +67,11 @@ void gen_random_string_array(int n, int min_len, int max_len,
 	
 	for (int i=0; i<n; ++i) {
 		int len = y(g);
-		char * s = new char[len];
+		char * s = new char[len+1];
 		for (int j=0; j<len; ++j) {
 			s[j] = x(g);
 		}
+		s[len] = 0;
 		vec.emplace_back(std::move(s));
 	}
 }
@@ -85,10 +86,36 @@ void gen_random_string_array(int n, int min_len, int max_len,
 	
 	for (int i=0; i<n; ++i) {
 		int len = y(g);
-		wchar_t * s = new wchar_t[len];
+		wchar_t * s = new wchar_t[len+1];
 		for (int j=0; j<len; ++j) {
 			s[j] = x(g);
 		}
+		s[len] = 0;
+		vec.emplace_back(std::move(s));
+	}
+}
+
+//
+// URL like strings: a few long shared prefixes followed by a short random path
+//
+void gen_prefixed_string_array(int n, std::vector<std::string>& vec, std::mt19937& g)
+{
+	const char* prefixes[] = {
+		"https://www.example.com/catalog/products/electronics/computers/laptops/",
+		"https://www.example.com/catalog/products/electronics/computers/desktops/",
+		"https://www.example.com/catalog/products/home/kitchen/",
+		"https://static.example.com/assets/images/thumbnails/2017/11/",
+	};
+	auto p = std::uniform_int_distribution<int>(0, 3);
+	auto x = std::uniform_int_distribution<int>('a', 'z');
+	auto y = std::uniform_int_distribution<int>(4, 24);
+
+	for (int i=0; i<n; ++i) {
+		std::string s = prefixes[p(g)];
+		int len = y(g);
+		for (int j=0; j<len; ++j) {
+			s.push_back(char(x(g)));
+		}
 		vec.emplace_back(std::move(s));
 	}
 }
@@ -111,8 +138,60 @@ void gen_random_int_array(int n, T min_v, T max_v,
 	}
 }
 
+template <typename T>
+void gen_random_float_array(int n, T min_v, T max_v,
+							std::vector<T>& vec,
+							std::mt19937& g)
+{
+	auto x = std::uniform_real_distribution<T>(min_v, max_v);
+	
+	for (int i=0; i<n; ++i) {
+		vec.emplace_back(x(g));
+	}
+}
+
 bool compare(unsigned a, unsigned b, int) { return a<b; }
 bool compare(int a, int b, int) { return a<b; }
+bool compare(float a, float b, int) { return a<b; }
+bool compare(uint64_t a, uint64_t b, int) { return a<b; }
+bool compare(int64_t a, int64_t b, int) { return a<b; }
+bool compare(double a, double b, int) { return a<b; }
+
+//
+// Records for the radix_sort_by benchmarks
+//
+struct order_t {
+	int64_t id;
+	double price;
+	std::string symbol;
+};
+
+struct symbol_order_t : order_t { };
+
+bool compare(const order_t& a, const order_t& b, int) { return a.id<b.id; }
+bool compare(const symbol_order_t& a, const symbol_order_t& b, int) { return a.symbol<b.symbol; }
+
+std::ostream& operator<<(std::ostream& os, const order_t& o) {
+	return os << o.id << ' ' << o.price << ' ' << o.symbol.c_str();
+}
+
+template <typename Order>
+void gen_random_order_array(int n, std::vector<Order>& vec, std::mt19937& g)
+{
+	std::vector<std::string> symbols;
+	gen_random_string_array(n, 2, 12, symbols, g);
+	
+	auto x = std::uniform_int_distribution<int64_t>(INT64_MIN, INT64_MAX);
+	auto y = std::uniform_real_distribution<double>(0, 1e6);
+	
+	for (int i=0; i<n; ++i) {
+		Order o;
+		o.id = x(g);
+		o.price = y(g);
+		o.symbol = std::move(symbols[i]);
+		vec.emplace_back(std::move(o));
+	}
+}
 
 template<typename T>
 void print(const T& l, const T& r) {
@@ -215,6 +294,62 @@ int main() {
 	std::vector<int32_t> vec8;
 	gen_random_int_array<int32_t>(1500000, 0x80000000, 0x7FFFFFFF, vec8, g);
 	benchmark("v int32", vec8, g, [](int32_t* f, int32_t* l){radix_sort(f,l);});
+	}{
+	std::vector<float> vec11;
+	gen_random_float_array<float>(1500000, -1e9f, 1e9f, vec11, g);
+	benchmark("v float", vec11, g, [](float* f, float* l){radix_sort(f,l);});
+	}{
+	std::vector<uint64_t> vec12;
+	gen_random_int_array<uint64_t>(1500000, 0, 0xFFFFFFFFFFFFFFFFull, vec12, g);
+	benchmark("v uint64", vec12, g, [](uint64_t* f, uint64_t* l){radix_sort(f,l);});
+	}{
+	std::vector<int64_t> vec13;
+	gen_random_int_array<int64_t>(1500000, INT64_MIN, INT64_MAX, vec13, g);
+	benchmark("v int64", vec13, g, [](int64_t* f, int64_t* l){radix_sort(f,l);});
+	}{
+	std::vector<double> vec14;
+	gen_random_float_array<double>(1500000, -1e18, 1e18, vec14, g);
+	benchmark("v double", vec14, g, [](double* f, double* l){radix_sort(f,l);});
+	}{
+	std::vector<uint32_t> vec18;
+	gen_random_int_array<uint32_t>(1500000, 0x5A000000, 0x5A0FFFFF, vec18, g);
+	benchmark("v uint32 narrow", vec18, g, [](uint32_t* f, uint32_t* l){radix_sort(f,l);});
+	}{
+	std::vector<uint64_t> vec19;
+	gen_random_int_array<uint64_t>(1500000, 1500000000000000ull, 1500000000000000ull + 3600000000ull, vec19, g);
+	benchmark("v uint64 narrow", vec19, g, [](uint64_t* f, uint64_t* l){radix_sort(f,l);});
+	}{
+	std::vector<uint16_t> vec3, scratch(1500000);
+	gen_random_int_array<uint16_t>(1500000, 0, 0xFFFF, vec3, g);
+	benchmark("v uint16 lsd", vec3, g, [&scratch](uint16_t* f, uint16_t* l){radix_sort_lsd(f,l,&scratch[0]);});
+	}{
+	std::vector<int16_t> vec4, scratch(1500000);
+	gen_random_int_array<int16_t>(1500000, 0x8000, 0x7FFF, vec4, g);
+	benchmark("v int16 lsd", vec4, g, [&scratch](int16_t* f, int16_t* l){radix_sort_lsd(f,l,&scratch[0]);});
+	}{
+	std::vector<uint32_t> vec7, scratch(1500000);
+	gen_random_int_array<uint32_t>(1500000, 0, 0xFFFFFFFF, vec7, g);
+	benchmark("v uint32 lsd", vec7, g, [&scratch](uint32_t* f, uint32_t* l){radix_sort_lsd(f,l,&scratch[0]);});
+	}{
+	std::vector<int32_t> vec8, scratch(1500000);
+	gen_random_int_array<int32_t>(1500000, 0x80000000, 0x7FFFFFFF, vec8, g);
+	benchmark("v int32 lsd", vec8, g, [&scratch](int32_t* f, int32_t* l){radix_sort_lsd(f,l,&scratch[0]);});
+	}{
+	std::vector<float> vec11, scratch(1500000);
+	gen_random_float_array<float>(1500000, -1e9f, 1e9f, vec11, g);
+	benchmark("v float lsd", vec11, g, [&scratch](float* f, float* l){radix_sort_lsd(f,l,&scratch[0]);});
+	}{
+	std::vector<uint64_t> vec12, scratch(1500000);
+	gen_random_int_array<uint64_t>(1500000, 0, 0xFFFFFFFFFFFFFFFFull, vec12, g);
+	benchmark("v uint64 lsd", vec12, g, [&scratch](uint64_t* f, uint64_t* l){radix_sort_lsd(f,l,&scratch[0]);});
+	}{
+	std::vector<int64_t> vec13, scratch(1500000);
+	gen_random_int_array<int64_t>(1500000, INT64_MIN, INT64_MAX, vec13, g);
+	benchmark("v int64 lsd", vec13, g, [&scratch](int64_t* f, int64_t* l){radix_sort_lsd(f,l,&scratch[0]);});
+	}{
+	std::vector<double> vec14, scratch(1500000);
+	gen_random_float_array<double>(1500000, -1e18, 1e18, vec14, g);
+	benchmark("v double lsd", vec14, g, [&scratch](double* f, double* l){radix_sort_lsd(f,l,&scratch[0]);});
 	}{//*/
 	std::vector<std::string> vec5;
 	gen_random_string_array(50000, 2, 10240, vec5, g);
@@ -224,6 +359,19 @@ int main() {
 	gen_random_string_array(50000, 2, 10240, vec9, g);
 	benchmark("v char*", vec9, g, [](char** f, char** l){radix_sort(f,l);});
 	}{
+	std::vector<std::string> vec5;
+	gen_random_string_array(50000, 2, 10240, vec5, g);
+	benchmark("v string cached", vec5, g, [](std::string* f, std::string* l){radix_sort_cached(f,l);});
+	}{
+	std::vector<char *> vec9;
+	gen_random_string_array(50000, 2, 10240, vec9, g);
+	benchmark("v char* cached", vec9, g, [](char** f, char** l){radix_sort_cached(f,l);});
+	}{
+	std::vector<std::string> vec20;
+	gen_prefixed_string_array(200000, vec20, g);
+	benchmark("v url", vec20, g, [](std::string* f, std::string* l){radix_sort(f,l);});
+	benchmark("v url cached", vec20, g, [](std::string* f, std::string* l){radix_sort_cached(f,l);});
+	}{
 	std::vector<std::wstring> vec6;
 	gen_random_string_array(50000, 2, 10240, vec6, g);
 	benchmark("v wstring", vec6, g, [](std::wstring* f, std::wstring* l){radix_sort(f,l);});
@@ -231,6 +379,36 @@ int main() {
 	std::vector<wchar_t *> vec10;
 	gen_random_string_array(50000, 2, 10240, vec10, g);
 	benchmark("v wchar_t*", vec10, g, [](wchar_t** f, wchar_t** l){radix_sort(f,l);});
+	}{
+	std::vector<order_t> vec15;
+	gen_random_order_array(500000, vec15, g);
+	benchmark("v order by id", vec15, g, [](order_t* f, order_t* l){
+		radix_sort_by(f, l, [](const order_t& o) { return o.id; });
+	});
+	}{
+	std::vector<symbol_order_t> vec16;
+	gen_random_order_array(500000, vec16, g);
+	benchmark("v order by symbol", vec16, g, [](symbol_order_t* f, symbol_order_t* l){
+		radix_sort_by(f, l, [](const symbol_order_t& o) -> const std::string& { return o.symbol; });
+	});
+	}{
+	std::vector<order_t> orders;
+	gen_random_order_array(500000, orders, g);
+	std::vector<int64_t> keys;
+	for (auto& o : orders) keys.push_back(o.id);
+	
+	auto start = std::chrono::steady_clock::now();
+	radix_sort_by_key(&keys[0], &keys[0]+keys.size(), &orders[0]);
+	auto end = std::chrono::steady_clock::now();
+	auto diff = std::chrono::duration_cast<std::chrono::microseconds>(end-start);
+	
+	for (size_t i=0; i<keys.size(); ++i) {
+		if (orders[i].id != keys[i] || (i && keys[i] < keys[i-1])) {
+			printf("v order soa: mismatch at %d\n", (int)i);
+			break;
+		}
+	}
+	printf("%s %d  time=%dus\n", "v order soa", (int)keys.size(), (int)diff.count());
 	}
 	
 	printf("\n");
@@ -0,0 +1,114 @@
+#include <utility>
+#include <cstdint>
+#include <cstdlib>
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <chrono>
+#include <ratio>
+#include "radix_parallel.h"
+
+
+
+using namespace azp;
+
+
+
+template <typename T>
+void gen_random_int_array(int n, T min_v, T max_v,
+							 std::vector<T>& vec,
+							 std::mt19937& g)
+{
+	auto x = std::uniform_int_distribution<T>(min_v, max_v);
+
+	for (int i=0; i<n; ++i) {
+		vec.emplace_back(x(g));
+	}
+}
+
+template <typename T, typename Fn>
+long long time_sort(const std::vector<T>& backup, const std::vector<T>& expected, Fn alg)
+{
+	long long time = 0x7FFFFFFFFFFFFFFLL;
+	std::vector<T> vec;
+
+	for (int i=0; i<5; ++i) {
+		vec = backup;
+		auto start = std::chrono::steady_clock::now();
+
+		alg(&vec[0], &vec[0]+vec.size());
+
+		auto end = std::chrono::steady_clock::now();
+		auto diff = std::chrono::duration_cast<std::chrono::nanoseconds>(end-start);
+
+		if (time > diff.count()) time = diff.count();
+	}
+
+	if (vec != expected) printf("sort failed\n");
+
+	return time / 1000;
+}
+
+//
+// Compares the single-threaded radix_sort with radix_sort_parallel using 1..max_threads threads
+//
+template <typename T>
+void benchmark_scaling(const char * desc, std::vector<T>& vec, uint32_t max_threads)
+{
+	std::vector<T> expected(vec);
+	std::sort(expected.begin(), expected.end());
+
+	auto serial = time_sort(vec, expected, [](T* f, T* l){ radix_sort(f,l); });
+	printf("%-10s %10d  radix_sort          %8dus\n", desc, (int)vec.size(), (int)serial);
+
+	for (uint32_t threads=1;; threads*=2) {
+		if (threads > max_threads) threads = max_threads;
+
+		auto time = time_sort(vec, expected, [threads](T* f, T* l){ radix_sort_parallel(f,l,threads); });
+		printf("%-10s %10d  parallel %3u thr    %8dus  speedup=%.2f\n", desc, (int)vec.size(),
+			threads, (int)time, double(serial)/double(time ? time : 1));
+
+		if (threads == max_threads) break;
+	}
+
+	printf("\n");
+}
+
+
+int main(int argc, char** argv) {
+	int size = (argc > 1) ? atoi(argv[1]) : 1 << 25;
+	uint32_t max_threads = (argc > 2) ? (uint32_t)atoi(argv[2]) : default_thread_count();
+
+	std::mt19937 g(0xCC6699);
+
+	{
+	std::vector<uint32_t> vec;
+	gen_random_int_array<uint32_t>(size, 0, 0xFFFFFFFF, vec, g);
+	benchmark_scaling("v uint32", vec, max_threads);
+	}{
+	std::vector<uint32_t> vec;
+	gen_random_int_array<uint32_t>(size, 0x5A000000, 0x5A0FFFFF, vec, g);
+	benchmark_scaling("v narrow", vec, max_threads);
+	}{
+	std::vector<int32_t> vec;
+	gen_random_int_array<int32_t>(size, 0x80000000, 0x7FFFFFFF, vec, g);
+	benchmark_scaling("v int32", vec, max_threads);
+	}{
+	std::vector<uint16_t> vec;
+	gen_random_int_array<uint16_t>(size, 0, 0xFFFF, vec, g);
+	benchmark_scaling("v uint16", vec, max_threads);
+	}{
+	std::vector<uint64_t> vec;
+	gen_random_int_array<uint64_t>(size, 0, 0xFFFFFFFFFFFFFFFFull, vec, g);
+	benchmark_scaling("v uint64", vec, max_threads);
+	}{
+	std::vector<double> vec;
+	std::uniform_real_distribution<double> x(-1e18, 1e18);
+	for (int i=0; i<size; ++i) vec.push_back(x(g));
+	benchmark_scaling("v double", vec, max_threads);
+	}
+
+	return 0;
+}
@@ -0,0 +1,241 @@
+#include <utility>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <random>
+#include <iostream>
+#include <chrono>
+#include <ratio>
+#include "radix_sort.h"
+
+
+
+using namespace azp;
+
+
+
+//
+// Records with few distinct keys, 'seq' is the position before sorting.
+// A stable sort leaves the records with equal keys ordered by 'seq'.
+//
+struct record_t {
+	uint32_t seq;
+	int32_t i32;
+	uint64_t u64;
+	float f32;
+	double f64;
+	std::string str;
+	std::wstring wstr;
+	const char* cstr;
+};
+
+
+const char* const words[] = { "", "a", "ab", "abc", "abd", "b", "ba", "bab", "babb", "c" };
+
+
+void gen_records(int n, int distinct, std::vector<record_t>& vec, std::mt19937& g)
+{
+	auto x = std::uniform_int_distribution<int>(0, distinct-1);
+	auto len = std::uniform_int_distribution<int>(0, 12);
+
+	//
+	// The strings share long prefixes, so the MSD passes go deeper than the first char
+	//
+	std::vector<std::string> strings;
+	for (int i=0; i<distinct; ++i) {
+		strings.push_back(std::string(len(g), 'k') + std::to_string(x(g) % 7));
+	}
+
+	for (int i=0; i<n; ++i) {
+		record_t r;
+		r.seq = uint32_t(i);
+		r.i32 = x(g) - distinct/2;
+		r.u64 = uint64_t(x(g)) << 40;
+		r.f32 = float(x(g) - distinct/2) / 4.0f;
+		r.f64 = double(x(g) - distinct/2) * 1e-3;
+		r.str = strings[x(g)];
+		// the chars 0x100 and 0x200 have a low digit 0 and aren't the end of the string
+		r.wstr = wchar_t(0x100 << (x(g) % 2)) + std::wstring(r.str.begin(), r.str.end()) + wchar_t(0x100 + x(g) % 3);
+		r.cstr = words[x(g) % (sizeof(words)/sizeof(words[0]))];
+		vec.push_back(std::move(r));
+	}
+}
+
+
+template <typename KeyFn, typename Less>
+bool check_stable(const char * desc, const std::vector<record_t>& backup, KeyFn key, Less less)
+{
+	auto expected = backup;
+	std::stable_sort(expected.begin(), expected.end(), [&](const record_t& l, const record_t& r) {
+		return less(key(l), key(r));
+	});
+
+	auto vec = backup;
+	stable_radix_sort_by(vec.begin(), vec.end(), key);
+
+	for (size_t i=0; i<vec.size(); ++i) {
+		if (vec[i].seq != expected[i].seq) {
+			printf("%-16s %8d  FAILED at %d\n", desc, (int)vec.size(), (int)i);
+			return false;
+		}
+	}
+
+	printf("%-16s %8d  ok\n", desc, (int)vec.size());
+	return true;
+}
+
+//
+// Sorts by the secondary key, then by the primary key, and compares with std::stable_sort
+//
+bool check_multi_key(const std::vector<record_t>& backup)
+{
+	auto expected = backup;
+	std::sort(expected.begin(), expected.end(), [](const record_t& l, const record_t& r) {
+		if (l.str != r.str) return l.str < r.str;
+		if (l.i32 != r.i32) return l.i32 < r.i32;
+		return l.seq < r.seq;
+	});
+
+	auto vec = backup;
+	stable_radix_sort_by(vec.begin(), vec.end(), [](const record_t& r) { return r.i32; });
+	stable_radix_sort_by(vec.begin(), vec.end(), [](const record_t& r) -> const std::string& { return r.str; });
+
+	for (size_t i=0; i<vec.size(); ++i) {
+		if (vec[i].seq != expected[i].seq) {
+			printf("%-16s %8d  FAILED at %d\n", "multi key", (int)vec.size(), (int)i);
+			return false;
+		}
+	}
+
+	printf("%-16s %8d  ok\n", "multi key", (int)vec.size());
+	return true;
+}
+
+//
+// Plain values: the result has to match std::stable_sort, the pointers of equal
+// C strings included
+//
+template <typename T, typename Less>
+bool check_values(const char * desc, std::vector<T> vec, Less less)
+{
+	auto expected = vec;
+	std::stable_sort(expected.begin(), expected.end(), less);
+
+	stable_radix_sort(&vec[0], &vec[0]+vec.size());
+
+	bool ok = (vec == expected);
+	printf("%-16s %8d  %s\n", desc, (int)vec.size(), ok ? "ok" : "FAILED");
+	return ok;
+}
+
+
+template <typename Fn>
+long long time_sort(const std::vector<record_t>& backup, Fn alg)
+{
+	long long time = 0x7FFFFFFFFFFFFFFLL;
+	std::vector<record_t> vec;
+
+	for (int i=0; i<5; ++i) {
+		vec = backup;
+		auto start = std::chrono::steady_clock::now();
+
+		alg(vec);
+
+		auto end = std::chrono::steady_clock::now();
+		auto diff = std::chrono::duration_cast<std::chrono::nanoseconds>(end-start);
+
+		if (time > diff.count()) time = diff.count();
+	}
+
+	return time / 1000;
+}
+
+template <typename KeyFn>
+void benchmark(const char * desc, const std::vector<record_t>& backup, KeyFn key)
+{
+	auto stl = time_sort(backup, [&key](std::vector<record_t>& vec) {
+		std::stable_sort(vec.begin(), vec.end(), [&key](const record_t& l, const record_t& r) {
+			return key(l) < key(r);
+		});
+	});
+
+	auto radix = time_sort(backup, [&key](std::vector<record_t>& vec) {
+		stable_radix_sort_by(vec.begin(), vec.end(), key);
+	});
+
+	printf("%-16s %8d  std::stable_sort %8dus  stable_radix_sort_by %8dus\n",
+		desc, (int)backup.size(), (int)stl, (int)radix);
+}
+
+
+int main(int argc, char** argv) {
+	int size = (argc > 1) ? atoi(argv[1]) : 1000000;
+	std::mt19937 g(0xCC6699);
+	bool ok = true;
+
+	std::vector<record_t> few;
+	gen_records(size, 50, few, g);
+	std::vector<record_t> many;
+	gen_records(size, 100000, many, g);
+
+	auto less = [](const auto& l, const auto& r) { return l < r; };
+	auto less_cstr = [](const char* l, const char* r) { return strcmp(l, r) < 0; };
+
+	for (auto* data : { &few, &many }) {
+		ok &= check_stable("by int32", *data, [](const record_t& r) { return r.i32; }, less);
+		ok &= check_stable("by uint64", *data, [](const record_t& r) { return r.u64; }, less);
+		ok &= check_stable("by float", *data, [](const record_t& r) { return r.f32; }, less);
+		ok &= check_stable("by double", *data, [](const record_t& r) { return r.f64; }, less);
+		ok &= check_stable("by string", *data, [](const record_t& r) -> const std::string& { return r.str; }, less);
+		ok &= check_stable("by wstring", *data, [](const record_t& r) -> const std::wstring& { return r.wstr; }, less);
+		ok &= check_stable("by char*", *data, [](const record_t& r) -> const char* const& { return r.cstr; }, less_cstr);
+		ok &= check_multi_key(*data);
+	}
+
+	{
+	std::vector<double> vec;
+	std::vector<char*> cvec;
+	for (auto& r : few) {
+		vec.push_back(r.f64);
+		cvec.push_back(&r.str[0]);
+	}
+	ok &= check_values("double", vec, less);
+	ok &= check_values("char*", cvec, less_cstr);
+	}
+
+	{
+	// wide chars with a low digit 0 followed by more chars
+	std::vector<std::wstring> wvec;
+	for (int i=0; i<200; ++i) wvec.push_back(i % 2 ? L"\u0100a" : L"\u0100b");
+	ok &= check_values("wstring 0x100", wvec, less);
+
+	auto wch = std::uniform_int_distribution<int>(32, 0xD7FF);
+	auto wlen = std::uniform_int_distribution<int>(1, 8);
+	wvec.clear();
+	for (int i=0; i<20000; ++i) {
+		std::wstring s;
+		for (int n=wlen(g); n>0; --n) s += wchar_t(wch(g));
+		wvec.push_back(s);
+	}
+	ok &= check_values("wstring random", wvec, less);
+
+	std::vector<wchar_t*> wcvec;
+	for (auto& s : wvec) wcvec.push_back(&s[0]);
+	ok &= check_values("wchar_t*", wcvec, [](const wchar_t* l, const wchar_t* r) { return wcscmp(l, r) < 0; });
+	}
+
+	printf("\n");
+
+	benchmark("int32 few", few, [](const record_t& r) { return r.i32; });
+	benchmark("int32 many", many, [](const record_t& r) { return r.i32; });
+	benchmark("double many", many, [](const record_t& r) { return r.f64; });
+	benchmark("string few", few, [](const record_t& r) -> const std::string& { return r.str; });
+	benchmark("string many", many, [](const record_t& r) -> const std::string& { return r.str; });
+
+	return ok ? 0 : 1;
+}
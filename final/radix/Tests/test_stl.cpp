@@ -106,6 +106,18 @@ void gen_random_int_array(int n, T min_v, T max_v,
 	}
 }
 
+template <typename T>
+void gen_random_float_array(int n, T min_v, T max_v,
+							std::vector<T>& vec,
+							std::mt19937& g)
+{
+	auto x = std::uniform_real_distribution<T>(min_v, max_v);
+	
+	for (int i=0; i<n; ++i) {
+		vec.emplace_back(x(g));
+	}
+}
+
 
 template <typename T, typename Fn>
 void benchmark(int size, const char * desc, std::vector<T>& vec, std::mt19937& g, Fn alg)
@@ -182,6 +194,18 @@ int main() {
 	std::vector<int32_t> vec8;
 	gen_random_int_array<int32_t>(1500000, 0x80000000, 0x7FFFFFFF, vec8, g);
 	benchmark("v int32", vec8, g, [](int32_t* f, int32_t* l){std::sort(f,l);});
+	}{
+	std::vector<uint64_t> vec12;
+	gen_random_int_array<uint64_t>(1500000, 0, 0xFFFFFFFFFFFFFFFFull, vec12, g);
+	benchmark("v uint64", vec12, g, [](uint64_t* f, uint64_t* l){std::sort(f,l);});
+	}{
+	std::vector<int64_t> vec13;
+	gen_random_int_array<int64_t>(1500000, INT64_MIN, INT64_MAX, vec13, g);
+	benchmark("v int64", vec13, g, [](int64_t* f, int64_t* l){std::sort(f,l);});
+	}{
+	std::vector<double> vec14;
+	gen_random_float_array<double>(1500000, -1e18, 1e18, vec14, g);
+	benchmark("v double", vec14, g, [](double* f, double* l){std::sort(f,l);});
 	}{//*/
 	std::vector<std::string> vec5;
 	gen_random_string_array(50000, 2, 10240, vec5, g);
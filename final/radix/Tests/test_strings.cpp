@@ -0,0 +1,87 @@
+#if defined(_MSC_VER)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#endif // _MSC_VER
+
+#include "../../../include/test_utils.h"
+#include "radix_sort.h"
+
+
+
+using namespace azp;
+
+
+
+//
+// String sorts on low entropy data sets, where most of the 256 radix partitions are empty
+//
+
+
+template <typename T>
+void CheckSorted(const std::vector<T>& vec) {
+	for (auto l=vec.begin(), r=l+1; r != vec.end(); ++l,++r) {
+		if (compare(*r, *l, 0)) {
+			print(*l, *r);
+			break;
+		}
+	}
+}
+
+
+//
+// benchmark() reassigns the vector it sorts, so the char* point into a copy
+//
+std::vector<char*> as_pointers(std::vector<std::string>& vec)
+{
+	std::vector<char*> res;
+	for (auto& s : vec) res.push_back(&s[0]);
+	return res;
+}
+
+
+void benchmark_strings(const char * desc, std::vector<std::string>& vec, std::mt19937& g)
+{
+	std::string name(desc);
+	std::vector<std::string> storage(vec);
+	auto pointers = as_pointers(storage);
+
+	benchmark((name + " std::sort").c_str(), vec, g, [](std::string* f, std::string* l){ std::sort(f,l); });
+	benchmark((name + " radix").c_str(), vec, g, [](std::string* f, std::string* l){ radix_sort(f,l); });
+	benchmark((name + " cached").c_str(), vec, g, [](std::string* f, std::string* l){ radix_sort_cached(f,l); });
+	benchmark((name + " char*").c_str(), pointers, g, [](char** f, char** l){ radix_sort(f,l); });
+	printf("\n");
+}
+
+
+int main(int argc, char** argv) {
+	int size = (argc > 1) ? atoi(argv[1]) : 500000;
+
+#if defined(_MSC_VER)
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+	if (GetThreadPriority(GetCurrentThread()) != THREAD_PRIORITY_HIGHEST) printf("Priority set failed\n");
+	 
+	if (!SetThreadAffinityMask(GetCurrentThread(), 1)) printf("Affinity set failed\n");
+#endif
+
+	std::mt19937 g(0xCC6699);
+
+	{
+	std::vector<std::string> vec;
+	gen_hex_id_array(size, vec, g);
+	benchmark_strings("hex ids", vec, g);
+	}{
+	std::vector<std::string> vec;
+	gen_dna_string_array(size, vec, g);
+	benchmark_strings("dna", vec, g);
+	}{
+	std::vector<std::string> vec;
+	gen_word_array(size, vec, g);
+	benchmark_strings("words", vec, g);
+	}{
+	std::vector<std::string> vec;
+	gen_random_string_array(size/10, 2, 1024, vec, g);
+	benchmark_strings("random", vec, g);
+	}
+
+	return 0;
+}
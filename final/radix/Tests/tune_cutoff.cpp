@@ -0,0 +1,213 @@
+//
+// Finds the partition size below which radix_sort stops recursing and sorts the partition
+// directly (radix_cutoff<T>::value) for each key type, on the current machine. For char
+// strings it also finds when to switch to multikey quicksort (radix_multikey<T>).
+// The output is the content of radix_thresholds.h:
+//
+//    tune_cutoff > radix_thresholds.h
+//
+#define RADIX_TUNING
+
+#include <utility>
+#include <cstdint>
+#include <cstdio>
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <ratio>
+#include "radix_sort.h"
+
+
+
+using namespace azp;
+
+
+
+const uint32_t candidates[] = { 8, 16, 24, 32, 48, 64, 96, 128, 192, 256 };
+const uint32_t multikey_sizes[] = { 0, 256, 1024 };
+const int32_t multikey_alphabets[] = { 0, 4, 16 };
+
+
+template <typename T>
+std::vector<T> gen_uniform(int n, std::mt19937_64& g)
+{
+	std::vector<T> vec;
+	for (int i=0; i<n; ++i) vec.push_back(T(g()));
+	return vec;
+}
+
+//
+// Many small partitions: the high bytes follow a geometric distribution
+//
+template <typename T>
+std::vector<T> gen_skewed(int n, std::mt19937_64& g)
+{
+	std::vector<T> vec;
+	for (int i=0; i<n; ++i) vec.push_back(T(g() >> (g() % (sizeof(T)*8))));
+	return vec;
+}
+
+template <typename String>
+std::vector<String> gen_strings(int n, int first_char, int last_char, std::mt19937_64& g)
+{
+	using char_t = typename String::value_type;
+
+	auto x = std::uniform_int_distribution<int>(first_char, last_char);
+	auto y = std::uniform_int_distribution<int>(2, 48);
+
+	std::vector<String> vec;
+	for (int i=0; i<n; ++i) {
+		String s(y(g), char_t(0));
+		for (auto& ch : s) ch = char_t(x(g));
+		vec.push_back(std::move(s));
+	}
+
+	return vec;
+}
+
+//
+// char* and wchar_t* arrays pointing into the strings of 'storage'
+//
+template <typename Char, typename String>
+std::vector<Char*> as_pointers(std::vector<String>& storage)
+{
+	std::vector<Char*> vec;
+	for (auto& s : storage) vec.push_back(&s[0]);
+	return vec;
+}
+
+
+template <typename T>
+long long time_sort(const std::vector<T>& backup)
+{
+	long long time = 0x7FFFFFFFFFFFFFFLL;
+	std::vector<T> vec;
+
+	for (int i=0; i<3; ++i) {
+		vec = backup;
+		auto start = std::chrono::steady_clock::now();
+
+		radix_sort(&vec[0], &vec[0]+vec.size());
+
+		auto end = std::chrono::steady_clock::now();
+		auto diff = std::chrono::duration_cast<std::chrono::nanoseconds>(end-start);
+
+		if (time > diff.count()) time = diff.count();
+	}
+
+	return time;
+}
+
+//
+// Returns the cutoff with the smallest total time over the data sets
+//
+template <typename T>
+uint32_t tune(const char * desc, const std::vector<std::vector<T>>& data)
+{
+	uint32_t best = 0;
+	long long best_time = 0x7FFFFFFFFFFFFFFLL;
+
+	for (auto cutoff : candidates) {
+		radix_cutoff<T>::value = cutoff;
+
+		long long time = 0;
+		for (auto& d : data) time += time_sort(d);
+
+		fprintf(stderr, "%-10s cutoff=%3u  time=%8dus\n", desc, cutoff, (int)(time/1000));
+
+		if (time < best_time) {
+			best_time = time;
+			best = cutoff;
+		}
+	}
+
+	return best;
+}
+
+//
+// Returns the multikey quicksort thresholds with the smallest total time over the data sets
+//
+template <typename T>
+std::pair<uint32_t, int32_t> tune_multikey(const char * desc, const std::vector<std::vector<T>>& data)
+{
+	std::pair<uint32_t, int32_t> best(0, 0);
+	long long best_time = 0x7FFFFFFFFFFFFFFLL;
+
+	for (auto size : multikey_sizes) {
+		for (auto alphabet : multikey_alphabets) {
+			radix_multikey<T>::max_size = size;
+			radix_multikey<T>::max_alphabet = alphabet;
+
+			long long time = 0;
+			for (auto& d : data) time += time_sort(d);
+
+			fprintf(stderr, "%-10s multikey size=%4u alphabet=%2d  time=%8dus\n", desc, size, alphabet, (int)(time/1000));
+
+			if (time < best_time) {
+				best_time = time;
+				best = std::make_pair(size, alphabet);
+			}
+		}
+	}
+
+	radix_multikey<T>::max_size = best.first;
+	radix_multikey<T>::max_alphabet = best.second;
+
+	return best;
+}
+
+
+int main() {
+	std::mt19937_64 g(0xCC6699);
+	const int size = 1000000;
+	const int string_size = 200000;
+
+	uint32_t u16 = tune<uint16_t>("uint16", { gen_uniform<uint16_t>(size, g), gen_skewed<uint16_t>(size, g) });
+	uint32_t u32 = tune<uint32_t>("uint32", { gen_uniform<uint32_t>(size, g), gen_skewed<uint32_t>(size, g) });
+	uint32_t u64 = tune<uint64_t>("uint64", { gen_uniform<uint64_t>(size, g), gen_skewed<uint64_t>(size, g) });
+
+	auto strings = gen_strings<std::string>(string_size, 32, 126, g);
+	auto lower = gen_strings<std::string>(string_size, 'a', 'z', g);
+	uint32_t str = tune<std::string>("string", { strings, lower });
+	uint32_t cstr = tune<char*>("char*", { as_pointers<char>(strings), as_pointers<char>(lower) });
+
+	//
+	// Low entropy strings: DNA like and hexadecimal
+	//
+	auto dna = gen_strings<std::string>(string_size, 'A', 'D', g);
+	auto hex = gen_strings<std::string>(string_size, '0', '?', g);
+	radix_cutoff<std::string>::value = str;
+	radix_cutoff<char*>::value = cstr;
+	auto str_mk = tune_multikey<std::string>("string", { strings, lower, dna, hex });
+	auto cstr_mk = tune_multikey<char*>("char*", { as_pointers<char>(strings), as_pointers<char>(lower),
+		as_pointers<char>(dna), as_pointers<char>(hex) });
+
+	auto wstrings = gen_strings<std::wstring>(string_size, 32, 0xD7FF, g);
+	auto wlower = gen_strings<std::wstring>(string_size, 'a', 'z', g);
+	uint32_t wstr = tune<std::wstring>("wstring", { wstrings, wlower });
+	uint32_t wcstr = tune<wchar_t*>("wchar_t*", { as_pointers<wchar_t>(wstrings), as_pointers<wchar_t>(wlower) });
+
+	printf("#pragma once\n\n");
+	printf("//\n");
+	printf("// Partition sizes below which radix_sort stops recursing, see radix_cutoff in radix_utils.h\n");
+	printf("// and the switch to multikey quicksort for strings, see radix_multikey\n");
+	printf("// Generated by Tests/tune_cutoff.cpp, run it again to calibrate for another machine:\n");
+	printf("//    tune_cutoff > radix_thresholds.h\n");
+	printf("//\n\n\n");
+	printf("namespace azp {\n\n\n");
+	printf("template <> struct radix_cutoff<uint16_t> { static const uint32_t value = %u; };\n", u16);
+	printf("template <> struct radix_cutoff<uint32_t> { static const uint32_t value = %u; };\n", u32);
+	printf("template <> struct radix_cutoff<uint64_t> { static const uint32_t value = %u; };\n", u64);
+	printf("template <> struct radix_cutoff<std::string> { static const uint32_t value = %u; };\n", str);
+	printf("template <> struct radix_cutoff<char*> { static const uint32_t value = %u; };\n", cstr);
+	printf("template <> struct radix_cutoff<std::wstring> { static const uint32_t value = %u; };\n", wstr);
+	printf("template <> struct radix_cutoff<wchar_t*> { static const uint32_t value = %u; };\n", wcstr);
+	printf("\n");
+	printf("template <> struct radix_multikey<std::string> { static const uint32_t max_size = %u; static const int32_t max_alphabet = %d; };\n", str_mk.first, str_mk.second);
+	printf("template <> struct radix_multikey<char*> { static const uint32_t max_size = %u; static const int32_t max_alphabet = %d; };\n", cstr_mk.first, cstr_mk.second);
+	printf("\n\n} // namespace azp\n");
+
+	return 0;
+}
@@ -0,0 +1,6 @@
+@echo off
+set C_FLAGS= /GmFyLA /EHsc /Zi /O2 /Oi /guard:cf- /Qvec-report:1 /arch:AVX /sdl- /W4 /nologo /D_CRT_SECURE_NO_WARNINGS
+rem set C_FLAGS= %C_FLAGS% /analyze 
+set L_FLAGS= /link /OPT:ICF
+
+cl.exe %C_FLAGS% -I".\\" tests\test_strings.cpp %L_FLAGS% 
@@ -0,0 +1,612 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include "radix_sort.h"
+
+
+//
+// Multi-threaded MSD radix sort for unsigned, signed and floating point keys.
+//
+// The algorithm has three phases:
+//  1. The histogram of the most significant (non-constant) byte is computed
+//     in per-thread chunks and merged.
+//  2. The elements are distributed in-place in parallel using the PARADIS
+//     speculative permutation + repair scheme.
+//  3. The resulting buckets are handed to a work-stealing pool. Large buckets
+//     are split by another radix pass and their sub-buckets become new tasks,
+//     small buckets are sorted with the single-threaded code.
+//
+
+
+namespace azp {
+
+
+//
+// Runtime variant of ExtractByOffset, used when the byte index is only known at runtime
+//
+template <typename T>
+struct ExtractByteAt {
+	// Type traits
+	typedef T value_type;
+	typedef scalar_key_t use_round;
+
+	explicit ExtractByteAt(int32_t offset)
+		: offset(offset)
+	{ }
+
+	uint8_t operator()(const T& val) const {
+		return ((const uint8_t*)&val)[offset];
+	}
+
+	const int32_t offset;
+};
+
+
+//
+// Sorts the range on the bytes [offset..0] using the single-threaded algorithm.
+// The bytes above 'offset' are assumed to be identical for all the elements.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+template <typename T>
+void radix_sort_bytes(T* first, T* last, int32_t offset)
+{
+	if (offset == 0) {
+		radix_pass_basic(first, last, ExtractByteAt<T>(0));
+		return;
+	}
+
+	radix_pass_recurse(first, last, ExtractByteAt<T>(offset), [offset](T* first, T* last) {
+		radix_sort_bytes(first, last, offset-1);
+	});
+}
+
+
+//
+// Calls fn(thread_index) on 'threads' threads, one of them being the calling thread,
+// and waits for all of them to finish.
+//
+template <typename Fn>
+void run_on_threads(uint32_t threads, Fn&& fn)
+{
+	std::vector<std::thread> pool;
+	pool.reserve(threads-1);
+
+	for (uint32_t t=1; t<threads; ++t) {
+		pool.emplace_back([&fn, t]() { fn(t); });
+	}
+
+	fn(0);
+
+	for (auto& th : pool) th.join();
+}
+
+
+//
+// Computes the histogram of byte 'offset' by splitting the range in one chunk per thread.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+template <typename T>
+partitions_t parallel_counts(T* first, T* last, int32_t offset, uint32_t threads)
+{
+	std::vector<partitions_t> local(threads);
+	size_t size = last - first;
+
+	run_on_threads(threads, [&](uint32_t t) {
+		auto begin = first + size*t/threads;
+		auto end = first + size*(t+1)/threads;
+		local[t] = compute_counts(begin, end, ExtractByteAt<T>(offset));
+	});
+
+	partitions_t partitions;
+
+	for (auto& l : local) {
+		for (int32_t i=0; i<256; ++i) {
+			partitions.count[i] += l.count[i];
+		}
+	}
+
+	return partitions;
+}
+
+
+//
+// Moves the elements into their partitions using all the threads (PARADIS).
+// Each round, the unsorted part of every partition is split in one stripe per thread.
+// The threads speculatively swap elements between their own stripes, then the partitions
+// are repaired in parallel by exchanging the misplaced elements with correct ones from the
+// end of the partition. What remains misplaced is processed in the next round.
+//
+// Preconditions:
+//  1. 'partitions' is the result of compute_ranges() for the same buffer and 'offset'
+//
+template <typename T>
+void parallel_swap_elements(T* first, const partitions_t& partitions, int32_t offset,
+							uint32_t threads)
+{
+	using stripes_t = std::array<uint32_t, 256>;
+
+	ExtractByteAt<T> ek(offset);
+
+	stripes_t head;
+	stripes_t tail;
+
+	for (int32_t i=0; i<256; ++i) {
+		head[i] = partitions.offset[i];
+		tail[i] = partitions.next_offset[i];
+	}
+
+	std::vector<stripes_t> stripe_head(threads);
+	std::vector<stripes_t> stripe_tail(threads);
+
+	uint64_t prev_remaining = ~0ull;
+
+	for (;;) {
+		uint64_t remaining = 0;
+		for (int32_t i=0; i<256; ++i) remaining += tail[i] - head[i];
+
+		if (!remaining) break;
+
+		//
+		// PARADIS guarantees progress each round, but we'd rather not depend on it.
+		// A single stripe per partition is the serial American flag sort which always completes.
+		//
+		if (remaining == prev_remaining) threads = 1;
+		prev_remaining = remaining;
+
+		for (int32_t i=0; i<256; ++i) {
+			uint64_t len = tail[i] - head[i];
+
+			for (uint32_t t=0; t<threads; ++t) {
+				stripe_head[t][i] = head[i] + uint32_t(len*t/threads);
+				stripe_tail[t][i] = head[i] + uint32_t(len*(t+1)/threads);
+			}
+		}
+
+		run_on_threads(threads, [&](uint32_t t) {
+			auto& sh = stripe_head[t];
+			auto& st = stripe_tail[t];
+
+			for (int32_t i=0; i<256; ++i) {
+				for (auto pos = sh[i]; pos < st[i];) {
+					T val = first[pos];
+					auto key = ek(val);
+
+					while (key != i && sh[key] < st[key]) {
+						std::swap(val, first[sh[key]++]);
+						key = ek(val);
+					}
+
+					if (key == i) {
+						first[pos++] = first[sh[i]];
+						first[sh[i]++] = val;
+					}
+					else {
+						first[pos++] = val;
+					}
+				}
+			}
+		});
+
+		//
+		// After the permutation, [stripe_head, stripe_tail) holds the misplaced elements of each stripe.
+		//
+		run_on_threads(threads, [&](uint32_t t) {
+			for (uint32_t i=t; i<256; i+=threads) {
+				auto end = tail[i];
+
+				for (uint32_t s=0; s<threads && stripe_head[s][i] < end; ++s) {
+					for (auto pos = stripe_head[s][i]; pos < stripe_tail[s][i] && pos < end; ++pos) {
+						T val = first[pos];
+						if (ek(val) == i) continue;
+
+						bool found = false;
+						while (pos+1 < end) {
+							T other = first[--end];
+							if (ek(other) == i) {
+								first[pos] = other;
+								first[end] = val;
+								found = true;
+								break;
+							}
+						}
+
+						if (!found) {
+							end = pos;
+							break;
+						}
+					}
+				}
+
+				head[i] = end;
+			}
+		});
+	}
+}
+
+
+//
+// Work-stealing pool which sorts the partitions left by the parallel distribution
+//
+template <typename T>
+class radix_task_pool {
+public:
+	struct task_t {
+		T* first;
+		T* last;
+		int32_t offset;
+	};
+
+	explicit radix_task_pool(uint32_t threads)
+		: _workers(threads), _pending(0)
+	{ }
+
+	//
+	// Adds a task to the queue of worker 't'. Can only be called before run().
+	//
+	void seed(uint32_t t, const task_t& task) {
+		_pending.fetch_add(1, std::memory_order_relaxed);
+		_workers[t].tasks.push_back(task);
+	}
+
+	void run() {
+		run_on_threads(uint32_t(_workers.size()), [this](uint32_t t) {
+			work(t);
+		});
+	}
+
+private:
+	//
+	// Partitions larger than this are split with another radix pass
+	// and their sub-partitions become tasks that can be stolen
+	//
+	static const uint32_t split_size = 1 << 16;
+
+	struct worker_t {
+		std::mutex lock;
+		std::deque<task_t> tasks;
+	};
+
+	void push(uint32_t t, const task_t& task) {
+		_pending.fetch_add(1, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> guard(_workers[t].lock);
+		_workers[t].tasks.push_back(task);
+	}
+
+	//
+	// The owner takes the newest task (depth first) while the thieves take the
+	// oldest one, which is usually the largest.
+	//
+	bool pop(uint32_t t, task_t& task) {
+		std::lock_guard<std::mutex> guard(_workers[t].lock);
+		if (_workers[t].tasks.empty()) return false;
+
+		task = _workers[t].tasks.back();
+		_workers[t].tasks.pop_back();
+		return true;
+	}
+
+	bool steal(uint32_t t, task_t& task) {
+		auto threads = uint32_t(_workers.size());
+
+		for (uint32_t i=1; i<threads; ++i) {
+			auto& victim = _workers[(t+i) % threads];
+
+			std::lock_guard<std::mutex> guard(victim.lock);
+			if (victim.tasks.empty()) continue;
+
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			return true;
+		}
+
+		return false;
+	}
+
+	void work(uint32_t t) {
+		task_t task;
+
+		for (;;) {
+			if (pop(t, task) || steal(t, task)) {
+				execute(t, task);
+				_pending.fetch_sub(1, std::memory_order_acq_rel);
+			}
+			else if (_pending.load(std::memory_order_acquire) == 0) {
+				return;
+			}
+			else {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void execute(uint32_t t, const task_t& task) {
+		if (task.last - task.first <= split_size || task.offset == 0) {
+			radix_sort_bytes(task.first, task.last, task.offset);
+			return;
+		}
+
+		ExtractByteAt<T> ek(task.offset);
+
+		partitions_t partitions = compute_counts(task.first, task.last, ek);
+		part_indeces_t valid_part;
+		auto vp_size = compute_ranges(partitions, valid_part);
+
+		swap_elements_into_place(task.first, partitions, valid_part, vp_size, ek);
+
+		uint32_t begin_offset = 0;
+		for (int32_t i=0; i<256; ++i) {
+			auto end_offset = partitions.next_offset[i];
+			auto diff = end_offset - begin_offset;
+
+			if (diff > radix_cutoff<T>::value) {
+				push(t, task_t{task.first+begin_offset, task.first+end_offset, task.offset-1});
+			}
+			else if (diff > 1) {
+				call_sort(task.first+begin_offset, task.first+end_offset);
+			}
+
+			begin_offset = end_offset;
+		}
+	}
+
+	std::vector<worker_t> _workers;
+	std::atomic<uint64_t> _pending;
+};
+
+
+//
+// Below this size the cost of starting the threads is larger than the gain
+//
+const ptrdiff_t min_parallel_size = 1 << 17;
+
+inline bool sort_serially(ptrdiff_t size, uint32_t threads) {
+	return threads < 2 || size < min_parallel_size;
+}
+
+
+//
+// Performs parallel radix sort on unsigned integral values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+template <typename T>
+void radix_sort_parallel_unsigned(T* first, T* last, uint32_t threads)
+{
+	if (sort_serially(last - first, threads)) {
+		radix_sort(first, last);
+		return;
+	}
+
+	if (threads > 256) threads = 256;
+
+	//
+	// Skip over the bytes that are identical for all the elements
+	//
+	int32_t offset = int32_t(sizeof(T)) - 1;
+	partitions_t partitions;
+	part_indeces_t valid_part;
+	int32_t vp_size;
+
+	for (;;) {
+		partitions = parallel_counts(first, last, offset, threads);
+		vp_size = compute_ranges(partitions, valid_part);
+
+		if (vp_size > 1 || offset == 0) break;
+		--offset;
+	}
+
+	if (vp_size < 2) return;
+
+	parallel_swap_elements(first, partitions, offset, threads);
+
+	if (offset == 0) return;
+
+	//
+	// Deal the partitions to the workers starting with the largest ones
+	//
+	using task_t = typename radix_task_pool<T>::task_t;
+
+	std::vector<task_t> tasks;
+	uint32_t begin_offset = 0;
+
+	for (int32_t i=0; i<256; ++i) {
+		auto end_offset = partitions.next_offset[i];
+
+		if (end_offset - begin_offset > 1) {
+			tasks.push_back(task_t{first+begin_offset, first+end_offset, offset-1});
+		}
+
+		begin_offset = end_offset;
+	}
+
+	std::sort(tasks.begin(), tasks.end(), [](const task_t& l, const task_t& r) {
+		return l.last - l.first > r.last - r.first;
+	});
+
+	radix_task_pool<T> pool(threads);
+
+	for (size_t i=0; i<tasks.size(); ++i) {
+		pool.seed(uint32_t(i % threads), tasks[i]);
+	}
+
+	pool.run();
+}
+
+
+//
+// Applies fn to every element using 'threads' threads
+//
+template <typename T, typename Fn>
+void parallel_transform(T* first, T* last, uint32_t threads, Fn&& fn)
+{
+	size_t size = last - first;
+
+	run_on_threads(threads, [&](uint32_t t) {
+		auto end = first + size*(t+1)/threads;
+		for (auto it = first + size*t/threads; it != end; ++it) fn(*it);
+	});
+}
+
+
+inline uint32_t default_thread_count()  {
+	auto threads = std::thread::hardware_concurrency();
+	return threads ? threads : 1;
+}
+
+
+//
+// Performs parallel radix sort on unsigned 16bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void radix_sort_parallel(uint16_t* first, uint16_t* last,
+								uint32_t threads = default_thread_count())
+{
+	radix_sort_parallel_unsigned(first, last, threads);
+}
+
+//
+// Performs parallel radix sort on unsigned 32bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void radix_sort_parallel(uint32_t* first, uint32_t* last,
+								uint32_t threads = default_thread_count())
+{
+	radix_sort_parallel_unsigned(first, last, threads);
+}
+
+//
+// Performs parallel radix sort on signed 32bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void radix_sort_parallel(int32_t* first, int32_t* last,
+								uint32_t threads = default_thread_count())
+{
+	// small: no threads for the sign flips either
+	if (sort_serially(last - first, threads)) {
+		radix_sort(first, last);
+		return;
+	}
+
+	uint32_t* f = (uint32_t*)first;
+	uint32_t* l = (uint32_t*)last;
+
+	parallel_transform(f, l, threads, [](uint32_t& v) { v += 0x80000000; });
+	radix_sort_parallel_unsigned(f, l, threads);
+	parallel_transform(f, l, threads, [](uint32_t& v) { v -= 0x80000000; });
+}
+
+//
+// Performs parallel radix sort on single precision floating point values.
+// See radix_sort(float*, float*) for details on the conversion.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. No NANs are present
+//
+inline void radix_sort_parallel(float* first, float* last,
+								uint32_t threads = default_thread_count())
+{
+	if (sort_serially(last - first, threads)) {
+		radix_sort(first, last);
+		return;
+	}
+
+	uint32_t* f = (uint32_t*)first;
+	uint32_t* l = (uint32_t*)last;
+
+	parallel_transform(f, l, threads, [](uint32_t& v) {
+		v ^= (v & 0x80000000) ? 0xFFFFFFFF : 0x80000000;
+	});
+
+	radix_sort_parallel_unsigned(f, l, threads);
+
+	parallel_transform(f, l, threads, [](uint32_t& v) {
+		v ^= (v & 0x80000000) ? 0x80000000 : 0xFFFFFFFF;
+	});
+}
+
+
+//
+// Performs parallel radix sort on unsigned 64bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void radix_sort_parallel(uint64_t* first, uint64_t* last,
+								uint32_t threads = default_thread_count())
+{
+	radix_sort_parallel_unsigned(first, last, threads);
+}
+
+//
+// Performs parallel radix sort on signed 64bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void radix_sort_parallel(int64_t* first, int64_t* last,
+								uint32_t threads = default_thread_count())
+{
+	if (sort_serially(last - first, threads)) {
+		radix_sort(first, last);
+		return;
+	}
+
+	uint64_t* f = (uint64_t*)first;
+	uint64_t* l = (uint64_t*)last;
+
+	parallel_transform(f, l, threads, [](uint64_t& v) { v += 0x8000000000000000ull; });
+	radix_sort_parallel_unsigned(f, l, threads);
+	parallel_transform(f, l, threads, [](uint64_t& v) { v -= 0x8000000000000000ull; });
+}
+
+//
+// Performs parallel radix sort on double precision floating point values.
+// See radix_sort(float*, float*) for details on the conversion.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. No NANs are present
+//
+inline void radix_sort_parallel(double* first, double* last,
+								uint32_t threads = default_thread_count())
+{
+	if (sort_serially(last - first, threads)) {
+		radix_sort(first, last);
+		return;
+	}
+
+	const uint64_t sign = 0x8000000000000000ull;
+
+	uint64_t* f = (uint64_t*)first;
+	uint64_t* l = (uint64_t*)last;
+
+	parallel_transform(f, l, threads, [sign](uint64_t& v) {
+		v ^= (v & sign) ? ~0ull : sign;
+	});
+
+	radix_sort_parallel_unsigned(f, l, threads);
+
+	parallel_transform(f, l, threads, [sign](uint64_t& v) {
+		v ^= (v & sign) ? sign : ~0ull;
+	});
+}
+
+
+} // namespace azp
@@ -0,0 +1,173 @@
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <iterator>
+
+
+//
+// Sorting algorithms for the small partitions left by the radix passes.
+// For these, the overhead of std::sort's introsort dominates the actual work.
+//  - up to 16 elements: Batcher odd-even merge sorting networks, generated at compile time
+//  - up to 64 elements: insertion sort with the minimum as a sentinel
+//  - larger: std::sort
+//
+// Less is a callable with the signature bool (const T& l, const T& r), returning true if l < r.
+//
+
+
+namespace azp {
+
+
+const uint32_t max_network_size = 16;
+const uint32_t max_insertion_size = 64;
+
+
+//
+// The comparators of a sorting network. A Batcher network for 16 elements has 63 of them.
+//
+struct network_t {
+	uint32_t size;
+	uint8_t pairs[64][2];
+};
+
+
+//
+// Generates Batcher's odd-even merge sorting network for 'n' elements.
+// The construction works for any n, not only for powers of 2.
+//
+constexpr network_t make_network(uint32_t n)
+{
+	network_t net{};
+
+	for (uint32_t p=1; p<n; p+=p) {
+		for (uint32_t k=p; k>=1; k/=2) {
+			for (uint32_t j=k%p; j+k<n; j+=2*k) {
+				for (uint32_t i=0; i<k && i+j+k<n; ++i) {
+					if ((i+j)/(2*p) == (i+j+k)/(2*p)) {
+						net.pairs[net.size][0] = uint8_t(i+j);
+						net.pairs[net.size][1] = uint8_t(i+j+k);
+						++net.size;
+					}
+				}
+			}
+		}
+	}
+
+	return net;
+}
+
+
+//
+// Scalar values (integers, floats, pointers) are exchanged without branches,
+// the compiler emits conditional moves. The other types are swapped only if needed.
+//
+template <typename T, typename Less>
+void compare_swap(T& l, T& r, Less& less, std::true_type)
+{
+	T a = l;
+	T b = r;
+	bool swap_needed = less(b, a);
+	l = swap_needed ? b : a;
+	r = swap_needed ? a : b;
+}
+
+template <typename T, typename Less>
+void compare_swap(T& l, T& r, Less& less, std::false_type)
+{
+	using std::swap;
+	if (less(r, l)) swap(l, r);
+}
+
+
+template <uint32_t N>
+struct sorting_network {
+	static constexpr network_t net = make_network(N);
+
+	template <typename RandomIt, typename Less>
+	static void sort(RandomIt first, Less& less)  {
+		apply(first, less, std::make_index_sequence<net.size>());
+	}
+
+private:
+	//
+	// The comparator indexes are constant expressions, so this expands to straight line code
+	//
+	template <typename RandomIt, typename Less, size_t... I>
+	static void apply(RandomIt first, Less& less, std::index_sequence<I...>)
+	{
+		using value_type = typename std::iterator_traits<RandomIt>::value_type;
+		using is_scalar = typename std::is_scalar<value_type>::type;
+
+		int expand[] = { 0, (compare_swap(first[net.pairs[I][0]], first[net.pairs[I][1]], less, is_scalar()), 0)... };
+		(void)expand;
+		(void)first;	// the networks of 0 and 1 element are empty
+		(void)less;
+	}
+};
+
+template <uint32_t N>
+constexpr network_t sorting_network<N>::net;
+
+
+template <typename RandomIt, typename Less, size_t... N>
+void network_sort(RandomIt first, uint32_t size, Less& less, std::index_sequence<N...>)
+{
+	using sort_fn = void (*)(RandomIt, Less&);
+	static const sort_fn table[] = { &sorting_network<N>::template sort<RandomIt, Less>... };
+
+	table[size](first, less);
+}
+
+
+//
+// Insertion sort. The minimum is moved to the front first, so the inner loop
+// doesn't need to check for the beginning of the range.
+//
+template <typename RandomIt, typename Less>
+void insertion_sort(RandomIt first, RandomIt last, Less& less)
+{
+	using std::swap;
+
+	auto min = first;
+	for (auto it=first+1; it!=last; ++it) {
+		if (less(*it, *min)) min = it;
+	}
+
+	swap(*first, *min);
+
+	for (auto it=first+2; it<last; ++it) {
+		auto val = std::move(*it);
+		auto pos = it;
+
+		for (; less(val, *(pos-1)); --pos) {
+			*pos = std::move(*(pos-1));
+		}
+
+		*pos = std::move(val);
+	}
+}
+
+
+//
+// Sorts a small range, picking the algorithm by size
+//
+template <typename RandomIt, typename Less>
+void small_sort(RandomIt first, RandomIt last, Less less)
+{
+	auto size = uint32_t(last - first);
+
+	if (size <= max_network_size) {
+		network_sort(first, size, less, std::make_index_sequence<max_network_size+1>());
+	}
+	else if (size <= max_insertion_size) {
+		insertion_sort(first, last, less);
+	}
+	else {
+		std::sort(first, last, less);
+	}
+}
+
+
+} // namespace azp
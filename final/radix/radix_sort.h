@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <type_traits>
 #include "radix_utils.h"
 
 
@@ -67,18 +69,16 @@ inline void radix_sort(int8_t* first, int8_t* last)  {
 }
 
 //
-// Performs radix sort on the range using the partitions based algorithm.
-// This is suited for larger more complex types. The 'continuation' functor will
-// be called for each partition in order to enable sorting on multiple bytes
+// Moves the elements of the range to their radix partitions, without sorting the partitions.
+// Returns the number of non-empty partitions.
 //
 // Preconditions:
 //  1. The range [first, last) will have less than UINT_MAX elements
 //
-template <typename RandomIt, typename ExtractKey, typename NextSort>
-void radix_pass_recurse(RandomIt first, RandomIt last, ExtractKey&& ek,
-						NextSort&& continuation) 
+template <typename RandomIt, typename ExtractKey>
+int32_t radix_pass_partition(RandomIt first, RandomIt last, ExtractKey& ek, partitions_t& partitions)
 {
-	partitions_t partitions = compute_counts(first, last, ek);
+	partitions = compute_counts(first, last, ek);
 
 	part_indeces_t valid_part;
 
@@ -91,9 +91,56 @@ void radix_pass_recurse(RandomIt first, RandomIt last, ExtractKey&& ek,
 		swap_elements_into_place(first, partitions, valid_part, vp_size, ek);
 	}
 
+	return vp_size;
+}
+
+//
+// Performs radix sort on the range using the partitions based algorithm.
+// This is suited for larger more complex types. The 'continuation' functor will
+// be called for each partition in order to enable sorting on multiple bytes
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+template <typename RandomIt, typename ExtractKey, typename NextSort>
+void radix_pass_recurse(RandomIt first, RandomIt last, ExtractKey&& ek,
+						NextSort&& continuation) 
+{
+	partitions_t partitions;
+	radix_pass_partition(first, last, ek, partitions);
+
 	recurse_depth_first(first, partitions, ek, continuation, typename ExtractKey::use_round());
 }
 
+//
+// Sorts unsigned values on the bytes [off..0], one radix pass per byte.
+// The bytes above 'off' are assumed to be identical for all the elements.
+// Only the bytes set in the 'digits' mask (see compute_varying_digits) get a pass,
+// the others are the same for all the elements and are skipped.
+//
+template <typename T, int32_t off>
+struct radix_bytes {
+	static void sort(T* first, T* last, uint32_t digits)  {
+		if (!(digits & (1u << off))) {
+			radix_bytes<T, off-1>::sort(first, last, digits);
+			return;
+		}
+
+		radix_pass_recurse(first, last, ExtractByOffset<T, off>(), [digits](T* first, T* last) {
+			radix_bytes<T, off-1>::sort(first, last, digits);
+		});
+	}
+};
+
+template <typename T>
+struct radix_bytes<T, 0> {
+	static void sort(T* first, T* last, uint32_t digits)  {
+		if (digits & 1) {
+			radix_pass_basic(first, last, ExtractByOffset<T, 0>());
+		}
+	}
+};
+
 //
 // Performs radix sort on unsigned 16bit values
 //
@@ -101,9 +148,7 @@ void radix_pass_recurse(RandomIt first, RandomIt last, ExtractKey&& ek,
 //  1. The range [first, last) will have less than UINT_MAX elements
 //
 inline void radix_sort(uint16_t* first, uint16_t* last)  {
-	radix_pass_recurse(first, last, ExtractByOffset<uint16_t, 1>(), [](uint16_t* first, uint16_t* last) {
-		radix_pass_basic(first, last, ExtractByOffset<uint16_t, 0>());
-	});
+	radix_bytes<uint16_t, 1>::sort(first, last, compute_varying_digits(first, last));
 }
 
 //
@@ -130,20 +175,8 @@ inline void radix_sort(int16_t* first, int16_t* last)  {
 // Preconditions:
 //  1. The range [first, last) will have less than UINT_MAX elements
 //
-inline void radix_sort(uint32_t* first, uint32_t* last) 
-{
-	using compose4 = ExtractByOffset<uint32_t, 3>;
-	using compose3 = ExtractByOffset<uint32_t, 2>;
-	using compose2 = ExtractByOffset<uint32_t, 1>;
-	using compose1 = ExtractByOffset<uint32_t, 0>;
-
-	radix_pass_recurse(first, last, compose4(), [](uint32_t* first, uint32_t* last) {
-		radix_pass_recurse(first, last, compose3(), [](uint32_t* first, uint32_t* last) {
-			radix_pass_recurse(first, last, compose2(), [](uint32_t* first, uint32_t* last) {
-				radix_pass_basic(first, last, compose1());
-			});
-		});
-	});
+inline void radix_sort(uint32_t* first, uint32_t* last)  {
+	radix_bytes<uint32_t, 3>::sort(first, last, compute_varying_digits(first, last));
 }
 
 //
@@ -200,6 +233,300 @@ inline void radix_sort(float* first, float* last)
 	for (; f!=l; ++f) *f ^= (*f & 0x80000000) ? 0x80000000 : 0xFFFFFFFF;
 }
 
+//
+// Performs radix sort on unsigned 64bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void radix_sort(uint64_t* first, uint64_t* last)  {
+	radix_bytes<uint64_t, 7>::sort(first, last, compute_varying_digits(first, last));
+}
+
+//
+// Performs radix sort on signed 64bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void radix_sort(int64_t* first, int64_t* last)
+{
+	uint64_t* f = (uint64_t*)first;
+	uint64_t* l = (uint64_t*)last;
+
+	for (; f!=l; ++f) *f += 0x8000000000000000ull;
+
+	f = (uint64_t*)first;
+	radix_sort(f,l);
+
+	for (; f!=l; ++f) *f -= 0x8000000000000000ull;
+}
+
+//
+// Performs radix sort on double precision floating point values.
+// See radix_sort(float*, float*) for the details of the conversion.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. No NANs are present
+//
+inline void radix_sort(double* first, double* last)
+{
+	const uint64_t sign = 0x8000000000000000ull;
+
+	uint64_t* f = (uint64_t*)first;
+	uint64_t* l = (uint64_t*)last;
+
+	for (; f!=l; ++f) *f ^= (*f & sign) ? ~0ull : sign;
+
+	f = (uint64_t*)first;
+	radix_sort(f,l);
+
+	for (; f!=l; ++f) *f ^= (*f & sign) ? sign : ~0ull;
+}
+
+
+//
+// Performs LSD radix sort on fixed width keys by moving the elements back and forth
+// between the range and 'scratch'. The histograms of all the bytes are computed in a single
+// pass over the data and the bytes that have the same value for all the elements are skipped.
+// KeyBits is a callable with the signature K (const T&), where K is an unsigned type whose
+// order is the sorting order (see ordered_bits). Every pass is a stable counting sort,
+// so elements with equal keys keep their relative order.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. 'scratch' points to a buffer of at least (last-first) elements
+//
+template <typename T, typename KeyBits>
+void radix_lsd(T* first, T* last, T* scratch, KeyBits bits)
+{
+	using key_t = decltype(bits(*first));
+
+	uint32_t size = uint32_t(last - first);
+	if (size < 2) return;
+
+	digit_counts_t<key_t> counts = {};
+	compute_digit_counts(first, last, bits, counts);
+
+	T* src = first;
+	T* dst = scratch;
+
+	for (size_t b=0; b<sizeof(key_t); ++b) {
+		auto& count = counts[b];
+
+		if (count[uint8_t(bits(*src) >> (b*8))] == size) continue;
+
+		uint32_t offset[256];
+		uint32_t sum = 0;
+
+		for (int32_t i=0; i<256; ++i) {
+			offset[i] = sum;
+			sum += count[i];
+		}
+
+		for (auto it=src, end=src+size; it!=end; ++it) {
+			dst[offset[uint8_t(bits(*it) >> (b*8))]++] = std::move(*it);
+		}
+
+		std::swap(src, dst);
+	}
+
+	if (src != first) {
+		std::move(src, src+size, first);
+	}
+}
+
+//
+// Functor for radix_lsd() on plain values
+//
+struct OrderedBits {
+	template <typename T>
+	auto operator()(T val) const -> decltype(ordered_bits(val))  {
+		return ordered_bits(val);
+	}
+};
+
+//
+// Performs LSD radix sort on unsigned 16bit values using the caller provided 'scratch' buffer
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. 'scratch' points to a buffer of at least (last-first) elements
+//
+inline void radix_sort_lsd(uint16_t* first, uint16_t* last, uint16_t* scratch)  {
+	radix_lsd(first, last, scratch, OrderedBits());
+}
+
+//
+// Performs LSD radix sort on signed 16bit values using the caller provided 'scratch' buffer
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. 'scratch' points to a buffer of at least (last-first) elements
+//
+inline void radix_sort_lsd(int16_t* first, int16_t* last, int16_t* scratch)  {
+	radix_lsd(first, last, scratch, OrderedBits());
+}
+
+//
+// Performs LSD radix sort on unsigned 32bit values using the caller provided 'scratch' buffer
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. 'scratch' points to a buffer of at least (last-first) elements
+//
+inline void radix_sort_lsd(uint32_t* first, uint32_t* last, uint32_t* scratch)  {
+	radix_lsd(first, last, scratch, OrderedBits());
+}
+
+//
+// Performs LSD radix sort on signed 32bit values using the caller provided 'scratch' buffer
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. 'scratch' points to a buffer of at least (last-first) elements
+//
+inline void radix_sort_lsd(int32_t* first, int32_t* last, int32_t* scratch)  {
+	radix_lsd(first, last, scratch, OrderedBits());
+}
+
+//
+// Performs LSD radix sort on single precision floating point values using the caller
+// provided 'scratch' buffer. See radix_sort(float*, float*) for the conversion details.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. 'scratch' points to a buffer of at least (last-first) elements
+//  3. No NANs are present
+//
+inline void radix_sort_lsd(float* first, float* last, float* scratch)  {
+	radix_lsd(first, last, scratch, OrderedBits());
+}
+
+//
+// Performs LSD radix sort on unsigned 64bit values using the caller provided 'scratch' buffer
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. 'scratch' points to a buffer of at least (last-first) elements
+//
+inline void radix_sort_lsd(uint64_t* first, uint64_t* last, uint64_t* scratch)  {
+	radix_lsd(first, last, scratch, OrderedBits());
+}
+
+//
+// Performs LSD radix sort on signed 64bit values using the caller provided 'scratch' buffer
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. 'scratch' points to a buffer of at least (last-first) elements
+//
+inline void radix_sort_lsd(int64_t* first, int64_t* last, int64_t* scratch)  {
+	radix_lsd(first, last, scratch, OrderedBits());
+}
+
+//
+// Performs LSD radix sort on double precision floating point values using the caller
+// provided 'scratch' buffer. See radix_sort(float*, float*) for the conversion details.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. 'scratch' points to a buffer of at least (last-first) elements
+//  3. No NANs are present
+//
+inline void radix_sort_lsd(double* first, double* last, double* scratch)  {
+	radix_lsd(first, last, scratch, OrderedBits());
+}
+
+
+//
+// Three-way radix quicksort (Bentley & Sedgewick) on strings whose first 'round' chars
+// are identical. The elements are partitioned into <, = and > the pivot char; the = part
+// continues with the next char, in the same loop. The chars of the current round are
+// loaded once into 'chars', which is permuted together with the strings, so the < and >
+// parts are partitioned again without touching the strings.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. 'chars' points to an array of (last-first) elements
+//  3. If 'loaded' is true, 'chars' holds the chars at position 'round' of the strings
+//
+template <typename String>
+void multikey_quicksort(String* first, String* last, uint8_t* chars, int32_t round, bool loaded)
+{
+	using std::swap;
+
+	for (;;) {
+		auto size = uint32_t(last - first);
+
+		if (size <= radix_cutoff<String>::value) {
+			if (size > 1) {
+				small_sort(first, last, [round](const String& l, const String& r) {
+					return compare(l, r, round);
+				});
+			}
+			return;
+		}
+
+		if (!loaded) {
+			for (uint32_t i=0; i<size; ++i) chars[i] = uint8_t(first[i][round]);
+		}
+
+		uint8_t a = chars[0];
+		uint8_t b = chars[size/2];
+		uint8_t c = chars[size-1];
+		uint8_t pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+
+		uint32_t lt = 0;
+		uint32_t gt = size;
+
+		for (uint32_t i=0; i<gt; ) {
+			uint8_t ch = chars[i];
+
+			if (ch < pivot) {
+				swap(first[lt], first[i]);
+				chars[i] = chars[lt];
+				chars[lt] = ch;
+				++lt;
+				++i;
+			}
+			else if (ch > pivot) {
+				--gt;
+				swap(first[i], first[gt]);
+				chars[i] = chars[gt];
+				chars[gt] = ch;
+			}
+			else {
+				++i;
+			}
+		}
+
+		multikey_quicksort(first, first+lt, chars, round, true);
+		multikey_quicksort(first+gt, last, chars+gt, round, true);
+
+		//
+		// The strings equal to the pivot ended, they are identical
+		//
+		if (pivot == 0) return;
+
+		first += lt;
+		last = first + (gt - lt);
+		chars += lt;
+		++round;
+		loaded = false;
+	}
+}
+
+//
+// Utility for multikey_quicksort(), allocates the char cache
+//
+template <typename String>
+void multikey_quicksort(String* first, String* last, int32_t round)
+{
+	std::vector<uint8_t> chars(last - first);
+	multikey_quicksort(first, last, chars.data(), round, false);
+}
 
 //
 // Utility function for strings of char like values
@@ -208,11 +535,29 @@ inline void radix_sort(float* first, float* last)
 //  1. The range [first, last) will have less than UINT_MAX elements
 //
 template <typename String>
-void radix_string(String* first, String* last, int32_t round)  {
-	radix_pass_recurse(first, last, ExtractStringChar<String>(round),
-		[round](String* first, String* last) {
-			radix_string(first, last, round+1);
-		});
+void radix_string(String* first, String* last, int32_t round)
+{
+	using multikey = radix_multikey<String>;
+
+	if (uint32_t(last - first) < multikey::max_size) {
+		multikey_quicksort(first, last, round);
+		return;
+	}
+
+	ExtractStringChar<String> ek(round);
+	partitions_t partitions;
+
+	auto vp_size = radix_pass_partition(first, last, ek, partitions);
+
+	recurse_depth_first(first, partitions, ek,
+		[round, vp_size](String* first, String* last) {
+			if (vp_size <= multikey::max_alphabet) {
+				multikey_quicksort(first, last, round+1);
+			}
+			else {
+				radix_string(first, last, round+1);
+			}
+		}, vector_key_t());
 }
 
 //
@@ -276,6 +621,607 @@ inline void radix_sort(wchar_t** first, wchar_t** last)  {
 }
 
 
+//
+// Utility for records sorted by a fixed width key, one radix pass per byte of the key
+//
+template <typename RandomIt, typename KeyFn, int32_t off>
+struct radix_key_bytes {
+	static void sort(RandomIt first, RandomIt last, const KeyFn& key)  {
+		radix_pass_recurse(first, last, ExtractKeyByte<KeyFn, off>(key), [&key](RandomIt first, RandomIt last) {
+			radix_key_bytes<RandomIt, KeyFn, off-1>::sort(first, last, key);
+		});
+	}
+};
+
+template <typename RandomIt, typename KeyFn>
+struct radix_key_bytes<RandomIt, KeyFn, 0> {
+	static void sort(RandomIt first, RandomIt last, const KeyFn& key)  {
+		radix_pass_basic(first, last, ExtractKeyByte<KeyFn, 0>(key));
+	}
+};
+
+//
+// Utility for records sorted by a string key
+//
+template <typename RandomIt, typename KeyFn>
+void radix_key_string(RandomIt first, RandomIt last, const KeyFn& key, int32_t round)  {
+	radix_pass_recurse(first, last, ExtractKeyChar<KeyFn>(key, round),
+		[&key, round](RandomIt first, RandomIt last) {
+			radix_key_string(first, last, key, round+1);
+		});
+}
+
+template <typename RandomIt, typename KeyFn>
+void radix_sort_by(RandomIt first, RandomIt last, const KeyFn& key, std::true_type)  {
+	using key_t = decltype(ordered_bits(key(*first)));
+	radix_key_bytes<RandomIt, KeyFn, int32_t(sizeof(key_t))-1>::sort(first, last, key);
+}
+
+template <typename RandomIt, typename KeyFn>
+void radix_sort_by(RandomIt first, RandomIt last, const KeyFn& key, std::false_type)  {
+	radix_key_string(first, last, key, 0);
+}
+
+//
+// Performs radix sort on records by the key returned by 'key'.
+// KeyFn is a callable with the signature K (const RandomIt::value_type&), where K is
+// an integral or floating point type, or a std::string / char* returned by reference.
+// The elements are moved with the unqualified call to swap(), which allows for
+// client customisation.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. No NANs are present in floating point keys
+//
+template <typename RandomIt, typename KeyFn>
+void radix_sort_by(RandomIt first, RandomIt last, KeyFn key)
+{
+	using key_t = typename std::decay<decltype(key(*first))>::type;
+
+	if (last - first < 2) return;
+
+	radix_sort_by(first, last, key, typename std::is_arithmetic<key_t>::type());
+}
+
+//
+// Performs radix sort on the 'keys' array and applies the same permutation to the parallel
+// 'payload' array. The keys are sorted together with their original index, so the payload
+// records are moved only once, when the permutation is applied at the end.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. 'payload' points to an array of at least (last-first) elements
+//  3. Key is an integral, floating point, std::string or char* type
+//
+template <typename Key, typename Payload>
+void radix_sort_by_key(Key* first, Key* last, Payload* payload)
+{
+	struct entry_t {
+		Key key;
+		uint32_t index;
+	};
+
+	uint32_t size = uint32_t(last - first);
+	if (size < 2) return;
+
+	std::vector<entry_t> entries;
+	entries.reserve(size);
+
+	for (uint32_t i=0; i<size; ++i) {
+		entries.push_back(entry_t{std::move(first[i]), i});
+	}
+
+	radix_sort_by(entries.begin(), entries.end(), [](const entry_t& e) -> const Key& {
+		return e.key;
+	});
+
+	for (uint32_t i=0; i<size; ++i) {
+		first[i] = std::move(entries[i].key);
+	}
+
+	//
+	// Follow the cycles of the permutation. Position i receives the record from
+	// entries[i].index; the visited positions are marked by pointing to themselves.
+	//
+	for (uint32_t i=0; i<size; ++i) {
+		if (entries[i].index == i) continue;
+
+		Payload tmp = std::move(payload[i]);
+		uint32_t pos = i;
+
+		for (;;) {
+			uint32_t src = entries[pos].index;
+			entries[pos].index = pos;
+
+			if (src == i) {
+				payload[pos] = std::move(tmp);
+				break;
+			}
+
+			payload[pos] = std::move(payload[src]);
+			pos = src;
+		}
+	}
+}
+
+
+
+//
+// Stable sorts. The elements are moved between the range and a buffer by counting passes,
+// so the elements with equal keys keep their relative order. This allows for multi-key
+// sorts: sort by the secondary key first, then by the primary key.
+//
+
+//
+// Utility for fixed width values, LSD radix sort with a temporary scratch buffer
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+template <typename T>
+void stable_radix_fixed(T* first, T* last)
+{
+	uint32_t size = uint32_t(last - first);
+	if (size < 2) return;
+
+	std::vector<T> scratch(size);
+	radix_lsd(first, last, &scratch[0], OrderedBits());
+}
+
+//
+// Utility for string keys, stable MSD radix sort on digit 'd' and the following ones.
+// The digits of the elements are stored in 'digits' by the counting loop and reused
+// by the moving loop. 'buffer' and 'digits' point to at least (last-first) elements.
+// Digits is a StringDigits instantiation.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+template <typename T, typename Digits>
+void stable_radix_digits(T* first, T* last, T* buffer, uint8_t* digits, const Digits& dg, int32_t d)
+{
+	using string_t = std::basic_string<typename Digits::char_type>;
+
+	uint32_t size = uint32_t(last - first);
+	uint32_t count[256];
+
+	for (;; ++d) {
+		if (size <= radix_cutoff<string_t>::value) {
+			std::stable_sort(first, last, [&dg, d](const T& l, const T& r) {
+				return dg.less(l, r, d);
+			});
+			return;
+		}
+
+		for (int32_t i=0; i<256; ++i) count[i] = 0;
+
+		for (uint32_t i=0; i<size; ++i) {
+			digits[i] = dg.digit(first[i], d);
+			++count[digits[i]];
+		}
+
+		//
+		// All the elements have the same digit, nothing to move
+		//
+		if (count[digits[0]] != size) break;
+		if (digits[0] == 0 && dg.end_of_string(first[0], d)) return;
+	}
+
+	uint32_t offset[256];
+	uint32_t sum = 0;
+
+	for (int32_t i=0; i<256; ++i) {
+		offset[i] = sum;
+		sum += count[i];
+	}
+
+	for (uint32_t i=0; i<size; ++i) {
+		buffer[offset[digits[i]]++] = std::move(first[i]);
+	}
+
+	std::move(buffer, buffer+size, first);
+
+	//
+	// The strings which ended are in partition 0 and are already sorted. The elements
+	// have the same previous digits, partition 0 has either ended or not as a whole.
+	//
+	bool ended = count[0] != 0 && dg.end_of_string(first[0], d);
+	uint32_t begin = ended ? count[0] : 0;
+	int32_t start = ended ? 1 : 0;
+
+	for (int32_t i=start; i<256; ++i) {
+		uint32_t end = begin + count[i];
+
+		if (count[i] > 1) {
+			stable_radix_digits(first+begin, first+end, buffer, digits, dg, d+1);
+		}
+
+		begin = end;
+	}
+}
+
+//
+// Utility for string keys, allocates the buffers for stable_radix_digits()
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+template <typename Char, typename T, typename StringFn>
+void stable_radix_string(T* first, T* last, const StringFn& str)
+{
+	uint32_t size = uint32_t(last - first);
+	if (size < 2) return;
+
+	std::vector<T> buffer(size);
+	std::vector<uint8_t> digits(size);
+
+	stable_radix_digits(first, last, &buffer[0], &digits[0], StringDigits<StringFn, Char>(str), 0);
+}
+
+//
+// Moves the records to the sorted order, 'index(i)' being the original position of the
+// record which goes to position i. The records are moved once to a buffer and back.
+//
+template <typename RandomIt, typename IndexFn>
+void move_to_order(RandomIt first, uint32_t size, IndexFn index)
+{
+	using value_type = typename std::iterator_traits<RandomIt>::value_type;
+
+	std::vector<value_type> buffer;
+	buffer.reserve(size);
+
+	for (uint32_t i=0; i<size; ++i) {
+		buffer.push_back(std::move(first[index(i)]));
+	}
+
+	std::move(buffer.begin(), buffer.end(), first);
+}
+
+//
+// Performs stable radix sort on unsigned 8bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void stable_radix_sort(uint8_t* first, uint8_t* last)  {
+	stable_radix_fixed(first, last);
+}
+
+//
+// Performs stable radix sort on signed 8bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void stable_radix_sort(int8_t* first, int8_t* last)  {
+	stable_radix_fixed(first, last);
+}
+
+//
+// Performs stable radix sort on unsigned 16bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void stable_radix_sort(uint16_t* first, uint16_t* last)  {
+	stable_radix_fixed(first, last);
+}
+
+//
+// Performs stable radix sort on signed 16bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void stable_radix_sort(int16_t* first, int16_t* last)  {
+	stable_radix_fixed(first, last);
+}
+
+//
+// Performs stable radix sort on unsigned 32bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void stable_radix_sort(uint32_t* first, uint32_t* last)  {
+	stable_radix_fixed(first, last);
+}
+
+//
+// Performs stable radix sort on signed 32bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void stable_radix_sort(int32_t* first, int32_t* last)  {
+	stable_radix_fixed(first, last);
+}
+
+//
+// Performs stable radix sort on single precision floating point values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. No NANs are present
+//
+inline void stable_radix_sort(float* first, float* last)  {
+	stable_radix_fixed(first, last);
+}
+
+//
+// Performs stable radix sort on unsigned 64bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void stable_radix_sort(uint64_t* first, uint64_t* last)  {
+	stable_radix_fixed(first, last);
+}
+
+//
+// Performs stable radix sort on signed 64bit values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void stable_radix_sort(int64_t* first, int64_t* last)  {
+	stable_radix_fixed(first, last);
+}
+
+//
+// Performs stable radix sort on double precision floating point values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. No NANs are present
+//
+inline void stable_radix_sort(double* first, double* last)  {
+	stable_radix_fixed(first, last);
+}
+
+//
+// Performs stable radix sort on std::string values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void stable_radix_sort(std::string* first, std::string* last)  {
+	stable_radix_string<char>(first, last, ElementString());
+}
+
+//
+// Performs stable radix sort on char* values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void stable_radix_sort(char** first, char** last)  {
+	stable_radix_string<char>(first, last, ElementString());
+}
+
+//
+// Performs stable radix sort on std::wstring values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void stable_radix_sort(std::wstring* first, std::wstring* last)  {
+	stable_radix_string<wchar_t>(first, last, ElementString());
+}
+
+//
+// Performs stable radix sort on wchar_t* values
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void stable_radix_sort(wchar_t** first, wchar_t** last)  {
+	stable_radix_string<wchar_t>(first, last, ElementString());
+}
+
+template <typename RandomIt, typename KeyFn>
+void stable_radix_sort_by(RandomIt first, RandomIt last, const KeyFn& key, std::true_type)
+{
+	using bits_t = decltype(ordered_bits(key(*first)));
+
+	struct entry_t {
+		bits_t bits;
+		uint32_t index;
+	};
+
+	uint32_t size = uint32_t(last - first);
+
+	std::vector<entry_t> entries;
+	std::vector<entry_t> scratch(size);
+	entries.reserve(size);
+
+	for (uint32_t i=0; i<size; ++i) {
+		entries.push_back(entry_t{ordered_bits(key(first[i])), i});
+	}
+
+	radix_lsd(&entries[0], &entries[0]+size, &scratch[0], [](const entry_t& e) {
+		return e.bits;
+	});
+
+	move_to_order(first, size, [&entries](uint32_t i) {
+		return entries[i].index;
+	});
+}
+
+template <typename RandomIt, typename KeyFn>
+void stable_radix_sort_by(RandomIt first, RandomIt last, const KeyFn& key, std::false_type)
+{
+	using char_t = typename std::decay<decltype(key(*first)[0])>::type;
+
+	uint32_t size = uint32_t(last - first);
+
+	std::vector<uint32_t> order(size);
+	for (uint32_t i=0; i<size; ++i) order[i] = i;
+
+	stable_radix_string<char_t>(&order[0], &order[0]+size, [first, &key](uint32_t i) -> decltype(key(*first)) {
+		return key(first[i]);
+	});
+
+	move_to_order(first, size, [&order](uint32_t i) {
+		return order[i];
+	});
+}
+
+//
+// Performs stable radix sort on records by the key returned by 'key'. The requirements on
+// KeyFn are the same as for radix_sort_by(). The keys are sorted together with the original
+// indexes of the records, then the records are moved to their place through a buffer,
+// so RandomIt::value_type has to be move constructible.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. No NANs are present in floating point keys
+//
+template <typename RandomIt, typename KeyFn>
+void stable_radix_sort_by(RandomIt first, RandomIt last, KeyFn key)
+{
+	using key_t = typename std::decay<decltype(key(*first))>::type;
+
+	if (last - first < 2) return;
+
+	stable_radix_sort_by(first, last, key, typename std::is_arithmetic<key_t>::type());
+}
+
+
+
+//
+// Prefix cached sort for strings. Every string is represented in a contiguous array by
+// an entry holding its index and a 'key' which caches the next 8 chars of the string, in big
+// endian order and padded with 0 after the end of the string. The entries are radix sorted
+// on the cached key and the strings are read again only for the groups which are still tied
+// after these 8 chars. radix_sort() instead reads one char through the string pointer for
+// every element in every round.
+//
+
+struct cached_key_t {
+	uint64_t key;
+	uint32_t index;
+};
+
+//
+// Returns the 8 chars of 'str' starting at position 'depth'
+//
+// Preconditions:
+//  1. 'str' has at least 'depth' chars
+//
+template <typename String>
+uint64_t load_cached_key(const String& str, int32_t depth)
+{
+	const char* s = &str[depth];
+	uint64_t key = 0;
+
+	for (int32_t i=0; i<8 && s[i]; ++i) {
+		key |= uint64_t(uint8_t(s[i])) << (56 - 8*i);
+	}
+
+	return key;
+}
+
+//
+// Sorts a group of entries whose strings have the same first 'depth' chars.
+// Before sorting, the chars which are the same for all the strings of the group are skipped:
+// the keys are loaded again after the common prefix, so the strings with long shared
+// prefixes (URLs, file paths) cost one pass per 8 chars and no radix passes.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+template <typename String>
+void radix_cached_group(cached_key_t* first, cached_key_t* last, const String* strings, int32_t depth)
+{
+	for (;;) {
+		uint64_t min = ~0ull;
+		uint64_t max = 0;
+
+		for (auto it=first; it!=last; ++it) {
+			it->key = load_cached_key(strings[it->index], depth);
+			min = std::min(min, it->key);
+			max = std::max(max, it->key);
+		}
+
+		//
+		// The common prefix of the group is the common prefix of the smallest and the largest key.
+		// A 0 in the common prefix means all the strings ended and are equal.
+		//
+		uint64_t diff = min ^ max;
+		if (diff == 0 && (min & 0xFF) == 0) return;
+
+		int32_t lcp = 0;
+		while (lcp < 8 && uint8_t(diff >> (56 - 8*lcp)) == 0) ++lcp;
+
+		if (lcp == 0) break;
+		depth += lcp;
+	}
+
+	radix_sort_by(first, last, [](const cached_key_t& e) {
+		return e.key;
+	});
+
+	//
+	// The strings of the tied entries continue after the cached chars, unless they ended
+	//
+	for (auto run=first; run!=last; ) {
+		auto end = run + 1;
+		while (end != last && end->key == run->key) ++end;
+
+		if (end - run > 1 && (run->key & 0xFF) != 0) {
+			radix_cached_group(run, end, strings, depth+8);
+		}
+
+		run = end;
+	}
+}
+
+//
+// Utility function for the prefix cached sort of char strings
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+template <typename String>
+void radix_cached_string(String* first, String* last)
+{
+	uint32_t size = uint32_t(last - first);
+	if (size < 2) return;
+
+	std::vector<cached_key_t> entries(size);
+	for (uint32_t i=0; i<size; ++i) entries[i].index = i;
+
+	radix_cached_group(&entries[0], &entries[0]+size, first, 0);
+
+	move_to_order(first, size, [&entries](uint32_t i) {
+		return entries[i].index;
+	});
+}
+
+//
+// Performs radix sort on std::string values, caching the key prefixes (see cached_key_t).
+// Faster than radix_sort() for large arrays and for strings with long common prefixes.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void radix_sort_cached(std::string* first, std::string* last)  {
+	radix_cached_string(first, last);
+}
+
+//
+// Performs radix sort on char* values, caching the key prefixes (see cached_key_t).
+// Faster than radix_sort() for large arrays and for strings with long common prefixes.
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//
+inline void radix_sort_cached(char** first, char** last)  {
+	radix_cached_string(first, last);
+}
+
+
 
 
 
@@ -0,0 +1,26 @@
+#pragma once
+
+//
+// Partition sizes below which radix_sort stops recursing, see radix_cutoff in radix_utils.h
+// and the switch to multikey quicksort for strings, see radix_multikey
+// Generated by Tests/tune_cutoff.cpp, run it again to calibrate for another machine:
+//    tune_cutoff > radix_thresholds.h
+//
+
+
+namespace azp {
+
+
+template <> struct radix_cutoff<uint16_t> { static const uint32_t value = 48; };
+template <> struct radix_cutoff<uint32_t> { static const uint32_t value = 64; };
+template <> struct radix_cutoff<uint64_t> { static const uint32_t value = 48; };
+template <> struct radix_cutoff<std::string> { static const uint32_t value = 64; };
+template <> struct radix_cutoff<char*> { static const uint32_t value = 16; };
+template <> struct radix_cutoff<std::wstring> { static const uint32_t value = 96; };
+template <> struct radix_cutoff<wchar_t*> { static const uint32_t value = 16; };
+
+template <> struct radix_multikey<std::string> { static const uint32_t max_size = 0; static const int32_t max_alphabet = 4; };
+template <> struct radix_multikey<char*> { static const uint32_t max_size = 256; static const int32_t max_alphabet = 0; };
+
+
+} // namespace azp
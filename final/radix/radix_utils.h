@@ -4,6 +4,9 @@
 #include <utility>
 #include <algorithm>
 #include <string.h>
+#include <type_traits>
+#include <iterator>
+#include "radix_small_sort.h"
 
 
 //
@@ -29,6 +32,54 @@ using part_indeces_t = std::array<uint8_t, 256>;
 using scalar_key_t = bool;
 using vector_key_t = int32_t;
 
+
+//
+// Partitions with at most radix_cutoff<T>::value elements don't get another radix pass,
+// they are sorted directly with small_sort(). The tuned values for each key type are
+// in radix_thresholds.h, which is generated by Tests/tune_cutoff.cpp.
+// With RADIX_TUNING defined the values become variables, so the tuner can change them.
+//
+#if defined(RADIX_TUNING)
+template <typename T>
+struct radix_cutoff {
+	static uint32_t value;
+};
+
+template <typename T>
+uint32_t radix_cutoff<T>::value = 64;
+#else
+template <typename T>
+struct radix_cutoff {
+	static const uint32_t value = 64;
+};
+#endif
+
+//
+// String partitions with less than radix_multikey<T>::max_size elements, or coming from a radix
+// pass which found at most radix_multikey<T>::max_alphabet distinct chars, are sorted with
+// multikey quicksort; most of the partitions of a 256 way radix pass would be empty.
+// 0 disables the switch. The values are calibrated by Tests/tune_cutoff.cpp as well.
+//
+#if defined(RADIX_TUNING)
+template <typename T>
+struct radix_multikey {
+	static uint32_t max_size;
+	static int32_t max_alphabet;
+};
+
+template <typename T>
+uint32_t radix_multikey<T>::max_size = 0;
+
+template <typename T>
+int32_t radix_multikey<T>::max_alphabet = 0;
+#else
+template <typename T>
+struct radix_multikey {
+	static const uint32_t max_size = 0;
+	static const int32_t max_alphabet = 0;
+};
+#endif
+
 //
 // The following types implement the ExtractKey concept's requirements
 //
@@ -104,6 +155,86 @@ struct ExtractWStringChar {
 };
 
 
+//
+// Maps a fixed width key to an unsigned value of the same size, such that the
+// unsigned order of the results matches the order of the keys.
+// See radix_sort(float*, float*) for the floating point conversion.
+//
+template <typename K>
+typename std::enable_if<std::is_unsigned<K>::value, K>::type ordered_bits(K key)  {
+	return key;
+}
+
+template <typename K>
+typename std::enable_if<std::is_integral<K>::value && std::is_signed<K>::value,
+						typename std::make_unsigned<K>::type>::type ordered_bits(K key)
+{
+	using U = typename std::make_unsigned<K>::type;
+	return U(key) ^ (U(1) << (sizeof(K)*8 - 1));
+}
+
+inline uint32_t ordered_bits(float key)  {
+	uint32_t bits;
+	memcpy(&bits, &key, sizeof(bits));
+	return bits ^ ((bits & 0x80000000) ? 0xFFFFFFFF : 0x80000000);
+}
+
+inline uint64_t ordered_bits(double key)  {
+	const uint64_t sign = 0x8000000000000000ull;
+	uint64_t bits;
+	memcpy(&bits, &key, sizeof(bits));
+	return bits ^ ((bits & sign) ? ~0ull : sign);
+}
+
+
+//
+// Functor for records sorted by a fixed width key, returns a byte of the projected key.
+// KeyFn is a callable with the signature K (const RandomIt::value_type&), where K is an
+// integral or floating point type.
+//
+template <typename KeyFn, int32_t off>
+struct ExtractKeyByte {
+	// Type traits
+	typedef scalar_key_t use_round;
+	
+	explicit ExtractKeyByte(const KeyFn& key)
+		: key(key)
+	{ }
+	
+	template <typename T>
+	uint8_t operator()(const T& val) const {
+		return uint8_t(ordered_bits(key(val)) >> (off*8));
+	}
+
+	const KeyFn& key;
+};
+
+
+//
+// Functor for records sorted by a string key, returns a char of the projected key.
+// KeyFn is a callable with the signature const String& (const RandomIt::value_type&),
+// where String is std::string or char*. The key is fetched for every round, so
+// returning by value would copy the string each time.
+//
+template <typename KeyFn>
+struct ExtractKeyChar {
+	// Type traits
+	typedef vector_key_t use_round;
+	
+	ExtractKeyChar(const KeyFn& key, int32_t offset)
+		: key(key), offset(offset)
+	{ }
+	
+	template <typename T>
+	uint8_t operator()(const T& val) const {
+		return key(val)[offset];
+	}
+
+	const KeyFn& key;
+	const int32_t offset;
+};
+
+
 struct partitions_t {
 	partitions_t()  { }
 	
@@ -123,18 +254,108 @@ struct partitions_t {
 //  2. The output parameter 'count' was 0-initialized
 //
 template <typename RandomIt, typename ExtractKey>
-partitions_t compute_counts(RandomIt first, RandomIt last, ExtractKey&& ek) 
+partitions_t compute_counts(RandomIt first, RandomIt last, ExtractKey&& ek)
 {
 	partitions_t partitions;
-	
-	for (uint32_t len=uint32_t(last-first); len; --len,++first) {
+	uint32_t len = uint32_t(last-first);
+
+	if (len < 1024) {
+		for (; len; --len,++first) {
+			++partitions.count[ek(*first)];
+		}
+
+		return partitions;
+	}
+
+	//
+	// Consecutive increments of the same counter stall on store-to-load forwarding,
+	// which makes skewed data (many identical bytes) 3x slower than random data.
+	// Spreading the consecutive elements over 4 tables breaks the dependency chain.
+	//
+	uint32_t count[3][256] = {};
+
+	for (; len >= 4; len -= 4, first += 4) {
+		++partitions.count[ek(first[0])];
+		++count[0][ek(first[1])];
+		++count[1][ek(first[2])];
+		++count[2][ek(first[3])];
+	}
+
+	for (; len; --len,++first) {
 		++partitions.count[ek(*first)];
 	}
-	
+
+	for (int32_t i=0; i<256; ++i) {
+		partitions.count[i] += count[0][i] + count[1][i] + count[2][i];
+	}
+
 	return partitions;
 }
 
 
+//
+// Histograms for every byte of a fixed width key, indexed by the byte offset
+//
+template <typename T>
+using digit_counts_t = std::array<std::array<uint32_t, 256>, sizeof(T)>;
+
+
+//
+// Counts the occurences of each byte value for all the bytes of the keys in a single pass.
+// KeyBits is a callable with the signature K (const T&), where K is an unsigned type whose
+// order is the sorting order (see ordered_bits).
+//
+// Preconditions:
+//  1. The range [first, last) will have less than UINT_MAX elements
+//  2. The output parameter 'counts' was 0-initialized
+//
+template <typename T, typename KeyBits>
+void compute_digit_counts(const T* first, const T* last, KeyBits bits, digit_counts_t<decltype(bits(*first))>& counts)
+{
+	using key_t = decltype(bits(*first));
+
+	for (; first != last; ++first) {
+		key_t key = bits(*first);
+
+		for (size_t b=0; b<sizeof(key_t); ++b) {
+			++counts[b][uint8_t(key >> (b*8))];
+		}
+	}
+}
+
+
+//
+// Returns a mask where bit 'b' is set if byte 'b' of the keys is not the same for all the elements.
+// The bytes which are constant don't need a radix pass. This is cheaper than the histograms of
+// compute_digit_counts() because the loop has no stores and is vectorized by the compiler.
+//
+// Preconditions:
+//  1. T is an unsigned integral type
+//
+template <typename T>
+uint32_t compute_varying_digits(const T* first, const T* last)
+{
+	if (first == last) return 0;
+
+	T all_and = *first;
+	T all_or = *first;
+
+	for (; first != last; ++first) {
+		all_and &= *first;
+		all_or |= *first;
+	}
+
+	uint64_t diff = uint64_t(all_and ^ all_or);
+	uint32_t digits = 0;
+
+	for (size_t b=0; b<sizeof(T); ++b) {
+		if ((diff >> (b*8)) & 0xFF) digits |= 1u << b;
+	}
+
+	return digits;
+}
+
+
 //
 // Converts the 'count' field in-place to corresponding start & end positions in the 'partitions' array.
 // Creates the vector of indexes to non-empty partitions 'valid_part' and returns its size
@@ -283,6 +504,11 @@ int32_t get_key_round(const ExtractWStringChar<S, false>& ek)  {
 	return ek.offset;
 }
 
+template <typename KeyFn>
+int32_t get_key_round(const ExtractKeyChar<KeyFn>& ek)  {
+	return ek.offset;
+}
+
 //
 // std::sort() comparison functions for strings. The first 'round' characters are
 // identical, so the comparison should start with the next character.
@@ -309,6 +535,81 @@ bool end_of_string(const String& str, int32_t round)  {
 	return str[round] == 0;
 }
 
+//
+// The element is its own key, except for the records sorted by a projected key
+//
+template <typename ExtractKey, typename T>
+bool end_of_key(const ExtractKey&, const T& el, int32_t round)  {
+	return end_of_string(el, round);
+}
+
+template <typename KeyFn, typename T>
+bool end_of_key(const ExtractKeyChar<KeyFn>& ek, const T& el, int32_t round)  {
+	return end_of_string(ek.key(el), round);
+}
+
+template <typename ExtractKey, typename T>
+bool compare_keys(const ExtractKey&, const T& l, const T& r, int32_t round)  {
+	return compare(l, r, round);
+}
+
+template <typename KeyFn, typename T>
+bool compare_keys(const ExtractKeyChar<KeyFn>& ek, const T& l, const T& r, int32_t round)  {
+	return compare(ek.key(l), ek.key(r), round);
+}
+
+//
+// Digits of a string key for the stable radix sort. StringFn is a callable with the
+// signature const String& (const T&), where String is a (w)string or a (w)char pointer.
+// A char is a single digit; a wchar_t is two, the high byte first (see ExtractWStringChar).
+// The end of the string is the char 0: a wchar_t like 0x100 has a last digit 0 too.
+//
+template <typename StringFn, typename Char>
+struct StringDigits {
+	typedef Char char_type;
+	static const int32_t digits_per_char = (sizeof(Char) == 1) ? 1 : 2;
+
+	explicit StringDigits(const StringFn& str)
+		: str(str)
+	{ }
+
+	template <typename T>
+	uint8_t digit(const T& el, int32_t d) const {
+		uint16_t ch = uint16_t(str(el)[d / digits_per_char]);
+		return uint8_t(ch >> (8 * (digits_per_char - 1 - d % digits_per_char)));
+	}
+
+	bool last_digit_of_char(int32_t d) const {
+		return d % digits_per_char == digits_per_char - 1;
+	}
+
+	// the string ends at the char of digit 'd'
+	template <typename T>
+	bool end_of_string(const T& el, int32_t d) const {
+		return last_digit_of_char(d) && str(el)[d / digits_per_char] == 0;
+	}
+
+	//
+	// The first 'd' digits are identical, the comparison starts with the char of digit 'd'
+	//
+	template <typename T>
+	bool less(const T& l, const T& r, int32_t d) const {
+		return compare(str(l), str(r), d / digits_per_char);
+	}
+
+	const StringFn str;
+};
+
+//
+// The element is its own string key
+//
+struct ElementString {
+	template <typename T>
+	const T& operator()(const T& str) const {
+		return str;
+	}
+};
+
 //
 // Calls the continuation function for each partition.
 // This function treats the key like a vector, the 'round' being the index
@@ -324,24 +625,25 @@ void recurse_depth_first(RandomIt first, const partitions_t& partitions,
 		auto end_offset = partitions.next_offset[i];
 		
 		auto endp = first+end_offset;
-		auto pp = std::partition(first+begin_offset, endp, [round](const auto& el) {
-			return end_of_string(el, round);
+		auto pp = std::partition(first+begin_offset, endp, [&ek, round](const auto& el) {
+			return end_of_key(ek, el, round);
 		});
 		
+		begin_offset = end_offset;
 		if (pp >= endp-1) continue;
 		
+		using value_type = typename std::iterator_traits<RandomIt>::value_type;
+
 		auto diff = endp - pp;
-		if (diff > 50) {		// magic number empirically determined
+		if (diff > radix_cutoff<value_type>::value) {
 			continuation(pp, endp);
 		}
 		else {
-			auto comp = [round](const auto& l, const auto& r) {
-				return compare(l, r, round);
+			auto comp = [&ek, round](const auto& l, const auto& r) {
+				return compare_keys(ek, l, r, round);
 			};
-			std::sort(pp, endp, comp);
+			small_sort(pp, endp, comp);
 		}
-		
-		begin_offset = end_offset;
 	}
 }
 
@@ -350,7 +652,10 @@ void recurse_depth_first(RandomIt first, const partitions_t& partitions,
 //
 template <typename RandomIt>
 void call_sort(RandomIt first, RandomIt last) {
-	std::sort(first, last);
+	auto comp = [](const auto& l, const auto& r) {
+		return l < r;
+	};
+	small_sort(first, last, comp);
 }
 
 template <>
@@ -358,7 +663,7 @@ void call_sort<wchar_t**>(wchar_t** first, wchar_t** last) {
 	auto comp = [](const wchar_t* l, const wchar_t* r) {
 		return compare(l, r, 0);
 	};
-	std::sort(first, last, comp);
+	small_sort(first, last, comp);
 }
 
 template <>
@@ -366,7 +671,23 @@ void call_sort<char**>(char** first, char** last) {
 	auto comp = [](const char* l, const char* r) {
 		return compare(l, r, 0);
 	};
-	std::sort(first, last, comp);
+	small_sort(first, last, comp);
+}
+
+//
+// Sorts a small partition. The records sorted by a projected key are compared by that key.
+//
+template <typename RandomIt, typename ExtractKey>
+void call_sort(RandomIt first, RandomIt last, const ExtractKey&) {
+	call_sort(first, last);
+}
+
+template <typename RandomIt, typename KeyFn, int32_t off>
+void call_sort(RandomIt first, RandomIt last, const ExtractKeyByte<KeyFn, off>& ek) {
+	auto comp = [&ek](const auto& l, const auto& r) {
+		return ordered_bits(ek.key(l)) < ordered_bits(ek.key(r));
+	};
+	small_sort(first, last, comp);
 }
 
 //
@@ -374,17 +695,19 @@ void call_sort<char**>(char** first, char** last) {
 //
 template <typename RandomIt, typename ExtractKey, typename NextSort>
 void recurse_depth_first(RandomIt first, const partitions_t& partitions,
-						 ExtractKey&&, NextSort&& continuation, scalar_key_t) 
+						 ExtractKey&& ek, NextSort&& continuation, scalar_key_t) 
 {
+	using value_type = typename std::iterator_traits<RandomIt>::value_type;
+
 	auto begin_offset = 0;
 	for (int32_t i=0; i<256; ++i) {
 		auto end_offset = partitions.next_offset[i];
 		auto diff = end_offset - begin_offset;
-		if (diff > 75) {		// magic number empirically determined
+		if (diff > radix_cutoff<value_type>::value) {
 			continuation(first+begin_offset, first+end_offset);
 		}
 		else if (diff > 1) {
-			call_sort(first+begin_offset, first+end_offset);
+			call_sort(first+begin_offset, first+end_offset, ek);
 		}
 		
 		begin_offset = end_offset;
@@ -393,3 +716,8 @@ void recurse_depth_first(RandomIt first, const partitions_t& partitions,
 
 	
 } // namespace azp
+
+
+#if !defined(RADIX_TUNING)
+	#include "radix_thresholds.h"
+#endif
@@ -8,6 +8,7 @@
 #include <chrono>
 #include <ratio>
 #include <algorithm>
+#include <cstring>
 
 
 template <typename T>
@@ -94,6 +95,67 @@ void gen_random_string_array(int n, int min_len, int max_len,
 }
 
 
+//
+// Low entropy strings: the chars are taken from 'alphabet'
+//
+inline 
+void gen_alphabet_string_array(int n, int min_len, int max_len, const char * alphabet,
+							   std::vector<std::string>& vec,
+							   std::mt19937& g)
+{
+	auto x = std::uniform_int_distribution<int>(0, (int)strlen(alphabet)-1);
+	auto y = std::uniform_int_distribution<int>(min_len, max_len);
+	
+	for (int i=0; i<n; ++i) {
+		int len = y(g);
+		std::string s;
+		s.resize(len);
+		for (int j=0; j<len; ++j) {
+			s[j] = alphabet[x(g)];
+		}
+		vec.emplace_back(std::move(s));
+	}
+}
+
+
+//
+// Fixed length hexadecimal ids
+//
+inline 
+void gen_hex_id_array(int n, std::vector<std::string>& vec, std::mt19937& g)
+{
+	gen_alphabet_string_array(n, 16, 16, "0123456789abcdef", vec, g);
+}
+
+
+//
+// DNA like keys: long strings over a 4 letter alphabet
+//
+inline 
+void gen_dna_string_array(int n, std::vector<std::string>& vec, std::mt19937& g)
+{
+	gen_alphabet_string_array(n, 20, 60, "ACGT", vec, g);
+}
+
+
+//
+// Lowercase words, the letters follow roughly their frequencies in English text.
+// Every word occurs 8 times on average.
+//
+inline 
+void gen_word_array(int n, std::vector<std::string>& vec, std::mt19937& g)
+{
+	std::vector<std::string> words;
+	gen_alphabet_string_array(n/8 + 1, 2, 12, "eeeeeeettttaaaaoooiiinnsshrdlcumwfgypbvkjxqz", words, g);
+	
+	auto x = std::uniform_int_distribution<int>(0, (int)words.size()-1);
+	
+	for (int i=0; i<n; ++i) {
+		vec.push_back(words[x(g)]);
+	}
+}
+
+
 template <typename U> struct other { typedef U type; };
 template <> struct other<int8_t> { typedef int type; };
 template <> struct other<uint8_t> { typedef int type; };
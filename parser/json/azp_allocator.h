@@ -60,7 +60,7 @@ struct monotonic_alloc_t {
 		// only the previously allocated buffer can be freed
 		if (advance(b.p, b.size) == _buffer) {
 			_buffer = b.p;
-			_size -= b.size;
+			_size += b.size;
 		}
 	}
 	
@@ -169,4 +169,161 @@ struct segregator_t {
 };
 
 
+//
+// Growable arena: a chain of chunks from the parent allocator, each one used as a
+// monotonic_alloc_t; when an allocation doesn't fit, a chunk twice as large as the
+// previous one (up to 'max_chunk', or the size of the allocation) is added.
+// Only the last allocation can be freed.
+// free_all returns the chunks to the parent, the cost doesn't depend on the number of
+// allocations; reset frees all the allocations and keeps the last chunk for the next use.
+//
+template <typename Parent>
+struct arena_alloc_t {
+	
+	struct chunk_t {
+		chunk_t* next;		// the previous chunk
+		size_t size;
+	};
+	
+	static const size_t alignment = 16;
+	static const size_t header = (sizeof(chunk_t) + alignment - 1) & ~(alignment - 1);
+	
+	static size_t align(size_t n) { return (n + alignment - 1) & ~(alignment - 1); }
+	
+	explicit arena_alloc_t(size_t first_chunk = 64 * 1024, size_t max_chunk = 1024 * 1024)
+		: _current(nullptr, 0), _chunks(nullptr), _next_size(first_chunk), _max_size(max_chunk) { }
+	
+	arena_alloc_t(const arena_alloc_t&) = delete;
+	arena_alloc_t& operator=(const arena_alloc_t&) = delete;
+	
+	~arena_alloc_t() {
+		free_all();
+	}
+	
+	block_t alloc(size_t n) {
+		n = align(n);
+		auto b = _current.alloc(n);
+		if (b.p || !add_chunk(n)) return b;
+		
+		return _current.alloc(n);
+	}
+	
+	void free(block_t b) {
+		b.size = align(b.size);
+		_current.free(b);
+	}
+	
+	bool owns(block_t b) const {
+		for (auto c = _chunks; c; c = c->next) {
+			if (b.p >= (void*)c && (char*)b.p + b.size <= (char*)c + c->size) return true;
+		}
+		return false;
+	}
+	
+	void free_all() {
+		while (_chunks) {
+			auto c = _chunks;
+			_chunks = c->next;
+			_parent.free(block_t{c, c->size});
+		}
+		_current = monotonic_alloc_t(nullptr, 0);
+	}
+	
+	void reset() {
+		if (!_chunks) return;
+		
+		auto last = _chunks;
+		_chunks = last->next;
+		free_all();
+		
+		last->next = nullptr;
+		_chunks = last;
+		_current = monotonic_alloc_t(advance(last, header), last->size - header);
+	}
+	
+	// bytes taken from the parent
+	size_t size() const {
+		size_t size = 0;
+		for (auto c = _chunks; c; c = c->next) size += c->size;
+		return size;
+	}
+	
+	bool add_chunk(size_t n) {
+		size_t size = (_next_size > n + header) ? _next_size : n + header;
+		auto b = _parent.alloc(size);
+		if (!b.p) return false;
+		
+		auto c = (chunk_t*)b.p;
+		c->next = _chunks;
+		c->size = size;
+		_chunks = c;
+		
+		_current = monotonic_alloc_t(advance(b.p, header), size - header);
+		if (_next_size < _max_size) _next_size *= 2;
+		return true;
+	}
+	
+	Parent _parent;
+	monotonic_alloc_t _current;
+	chunk_t* _chunks;
+	size_t _next_size;
+	size_t _max_size;
+};
+
+
+//
+// Free lists by size, for the parents which cannot free (like arena_alloc_t): the blocks
+// of up to 'max_size' bytes which are freed are kept in a list per multiple of
+// 'granularity' and reused for the next allocations of the same size class.
+// The parent must round the sizes up to a multiple of 'granularity'.
+//
+template <typename Parent, size_t max_size, size_t granularity = 16>
+struct size_class_alloc_t {
+	
+	struct node_t { struct node_t* next; };
+	
+	static const size_t classes = max_size / granularity + 1;
+	
+	static size_t size_class(size_t n) { return (n + granularity - 1) / granularity; }
+	
+	size_class_alloc_t() {
+		drop_free_lists();
+	}
+	
+	block_t alloc(size_t n) {
+		auto c = size_class(n);
+		if (c < classes && _heads[c]) {
+			block_t b = {_heads[c], n};
+			_heads[c] = _heads[c]->next;
+			return b;
+		}
+		
+		return _parent.alloc(n);
+	}
+	
+	void free(block_t b) {
+		auto c = size_class(b.size);
+		if (c < classes && b.size >= sizeof(node_t)) {
+			// cppcheck-suppress cstyleCast
+			node_t* node = (node_t*)b.p;
+			node->next = _heads[c];
+			_heads[c] = node;
+		}
+		else {
+			_parent.free(b);
+		}
+	}
+	
+	bool owns(block_t b) { return _parent.owns(b); }
+	
+	// the blocks in the lists belong to the parent, they're not returned one by one
+	void drop_free_lists() {
+		for (auto& h : _heads) h = nullptr;
+	}
+	
+	Parent _parent;
+	node_t* _heads[classes];
+};
+
+
 } // namespace azp
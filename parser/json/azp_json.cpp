@@ -1,11 +1,26 @@
 #include <stdlib.h>
-#include <locale.h>
 #include <cmath>
 #include <climits>
 #include <string.h>
 #include "azp_json.h"
+#include "azp_json_pow5.h"
 #include <memory>
+#include <algorithm>
+#include <iterator>
 #include <charconv>
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+#if defined(_M_X64) || defined(__x86_64__)
+	#define AZP_JSON_SIMD 1
+	#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+	#define AZP_FORCE_INLINE __forceinline
+#else
+	#define AZP_FORCE_INLINE inline __attribute__((always_inline))
+#endif
 
 
 namespace azp {
@@ -14,20 +29,15 @@ namespace azp {
 static bool parseJson(parser_base_t& p, char * first, char * last);
 static bool parse_error(parser_base_t& p, ParserErrors err, const char * curPtr);
 
-	
-bool parseJson(parser_t& p, char * first, char * last) {
+
+typedef bool (* parse_fn_t)(parser_base_t& p, char * first, char * last);
+
+// The number conversion doesn't depend on the locale (see convertDouble): the parser
+// doesn't change the (process wide) locale and can run on several threads.
+static bool parseBuffer(parser_base_t& p, char * first, char * last, parse_fn_t parse) {
 	p._first = first;
 	
-	auto old = setlocale(LC_NUMERIC, "C");
-	if (!old) {
-		return parse_error(p, Runtime_error, first);
-	}
-	
-	bool result = parseJson(static_cast<parser_base_t&>(p), first, last);
-	
-	if (!setlocale(LC_NUMERIC, old) && result) {	// set the error type only if result == true
-		return parse_error(p, Runtime_error, first);
-	}
+	bool result = parse(p, first, last);
 	
 	if (result) {
 		p.parsed_offset = p.parsed - first;
@@ -39,6 +49,11 @@ bool parseJson(parser_t& p, char * first, char * last) {
 	return result;
 }
 
+	
+bool parseJson(parser_t& p, char * first, char * last) {
+	return parseBuffer(p, first, last, &parseJson);
+}
+
 
 bool parseJson(parser_t& p, const char * first, const char * last)
 {
@@ -251,99 +266,565 @@ static bool call_string_callback(parser_base_t& p, char* start, char * end,
 }
 
 
+//
+// String scanning. The characters which end the fast copy-free path of parseString are
+// '"', '\\' and the control chars < 0x20 (these are invalid). The vector versions test
+// 16 (SSE2) or 32 (AVX2) characters at a time; the AVX2 version is selected at runtime.
+//
+
+inline bool isStringSpecial(char c) {
+	return (c == '"') | (c == '\\') | ((uint8_t)c < 0x20);
+}
+
+
+// returns the position of the first special character in [first, last), or 'last'
+static char * findStringSpecialScalar(char * first, char * last) {
+	for (; first != last; ++first) {
+		if (isStringSpecial(*first)) return first;
+	}
+	return first;
+}
+
+
+#if defined(AZP_JSON_SIMD)
+
+#if defined(_MSC_VER)
+	#define AZP_TARGET_AVX2
+#else
+	#define AZP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+inline uint32_t countTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+	unsigned long pos;
+	_BitScanForward(&pos, mask);
+	return pos;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+
+static char * findStringSpecialSSE2(char * first, char * last) {
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i bslash = _mm_set1_epi8('\\');
+	const __m128i ctrl = _mm_set1_epi8(0x1F);
+	
+	for (; last - first >= 16; first += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)first);
+		__m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));	// v <= 0x1F
+		
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(m);
+		if (mask) return first + countTrailingZeros(mask);
+	}
+	
+	return findStringSpecialScalar(first, last);
+}
+
+
+AZP_TARGET_AVX2
+static char * findStringSpecialAVX2(char * first, char * last) {
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i bslash = _mm256_set1_epi8('\\');
+	const __m256i ctrl = _mm256_set1_epi8(0x1F);
+	
+	for (; last - first >= 32; first += 32) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)first);
+		__m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, bslash));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctrl), v));	// v <= 0x1F
+		
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(m);
+		if (mask) return first + countTrailingZeros(mask);
+	}
+	
+	return findStringSpecialSSE2(first, last);
+}
+
+
+static bool cpuHasAVX2() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;	// the OS saves the YMM registers
+	
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+
+typedef char * (* find_special_t)(char * first, char * last);
+
+static char * findStringSpecial(char * first, char * last) {
+	static const find_special_t impl = cpuHasAVX2() ? &findStringSpecialAVX2 : &findStringSpecialSSE2;
+	return impl(first, last);
+}
+
+#else
+
+static char * findStringSpecial(char * first, char * last) {
+	return findStringSpecialScalar(first, last);
+}
+
+#endif // AZP_JSON_SIMD
+
+
+// assumes that '\' was already parsed; writes the unescaped character(s) at '*pCur'
+static bool unescapeChar(parser_base_t& p, char * first, char * last, char ** pCur) {
+	char c = *first;
+	
+	if (c == 'u') {
+		return unescapeUnicodeChar(p, first+1, last, pCur);
+	}
+	
+	if ((c == '"') | (c == '\\') | (c == '/')) {
+	}
+	else if (c == 'n') {
+		c = '\n';
+	}
+	else if (c == 'r') {
+		c = '\r';
+	}
+	else if (c == 't') {
+		c = '\t';
+	}
+	else if (c == 'b') {
+		c = '\b';
+	}
+	else if (c == 'f') {
+		c = '\f';
+	}
+	else {
+		return parse_error(p, Invalid_escape, first);
+	}
+	
+	*(*pCur)++ = c;
+	p.parsed = first+1;
+	return true;
+}
+
+
 // assumes that '"' was already parsed
 static bool parseString(parser_base_t& p, char * first, char * last, ParserTypes report_type)
 {
 	auto start = first;
-	auto cur = first;
-	char c;
 	
 	// Don't copy unless necessary -> find first escape
-	for (;first != last; ++first) {
-		c = *first;
+	first = findStringSpecial(first, last);
+	if (first == last) return parse_error(p, No_string_end, start-1);
+	
+	if (*first == '"') {
+		p.parsed = first+1;
+		return call_string_callback(p, start, first, report_type);
+	}
+	
+	auto cur = first;
+	
+	for (;;) {
+		// these values should have been escaped
+		if (*first != '\\') return parse_error(p, Invalid_char, first);
+		
+		// process escape sequence
+		first++;
+		if (first == last) return parse_error(p, No_string_end, start-1);
+		
+		if (!unescapeChar(p, first, last, &cur)) return false;
+		first = p.parsed;
+		
+		// move the normal characters which follow, as a block
+		auto stop = findStringSpecial(first, last);
+		memmove(cur, first, stop-first);
+		cur += stop-first;
+		first = stop;
+		
+		if (first == last) return parse_error(p, No_string_end, start-1);
+		
 		// end of string
-		if (c == '"') {
+		if (*first == '"') {
 			p.parsed = first+1;
-			return call_string_callback(p, start, first, report_type);
+			return call_string_callback(p, start, cur, report_type);
 		}
-		
-		if (c == '\\') {
-			cur = first;
-			goto _escape_seq;
+	}
+}
+
+
+//
+// Number conversion
+//
+// The parser converts the numbers itself, without the C runtime, with the same results as
+// std::from_chars (the correctly rounded double, no locale).
+// The digits are read 8 at a time: 8 chars are loaded in a 64-bit word, checked and
+// combined in 3 multiplications (SWAR). The doubles are computed with Clinger's fast path
+// when the significand and the power of 10 are exact doubles, otherwise with the
+// Eisel-Lemire algorithm: the product of the significand and of a 128-bit approximation
+// of the power of 5 gives the rounded result. With more than 19 significant digits the
+// truncated significand may not decide the rounding (w and w+1 round differently), then
+// std::from_chars converts the number (very rare, the JSON numbers are short).
+// Define AZP_JSON_FROM_CHARS to convert all the numbers with std::from_chars.
+//
+#if !defined(AZP_JSON_FROM_CHARS)
+
+struct value128_t {
+	uint64_t low;
+	uint64_t high;
+};
+
+
+inline value128_t multiply64(uint64_t a, uint64_t b) {
+	value128_t r;
+#if defined(_MSC_VER) && defined(_M_X64)
+	r.low = _umul128(a, b, &r.high);
+#elif defined(__SIZEOF_INT128__)
+	unsigned __int128 x = (unsigned __int128)a * b;
+	r.low = uint64_t(x);
+	r.high = uint64_t(x >> 64);
+#else
+	uint64_t a_lo = uint32_t(a), a_hi = a >> 32;
+	uint64_t b_lo = uint32_t(b), b_hi = b >> 32;
+	uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+	uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+	uint64_t cross = (lo_lo >> 32) + uint32_t(hi_lo) + lo_hi;
+	r.low = (cross << 32) | uint32_t(lo_lo);
+	r.high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+#endif
+	return r;
+}
+
+
+// assumes x != 0
+inline uint32_t countLeadingZeros64(uint64_t x) {
+#if defined(_MSC_VER)
+	unsigned long pos;
+	if (_BitScanReverse(&pos, uint32_t(x >> 32))) return 31 - pos;
+	_BitScanReverse(&pos, uint32_t(x));
+	return 63 - pos;
+#else
+	return __builtin_clzll(x);
+#endif
+}
+
+
+// 8 chars, the first one in the low byte (little endian)
+inline uint64_t load8(const char * s) {
+	uint64_t v;
+	memcpy(&v, s, 8);
+	return v;
+}
+
+
+inline bool isEightDigits(uint64_t v) {
+	// each byte - '0' and + (0x7F - '9') must not overflow into the high bit
+	return (((v + 0x4646464646464646) | (v - 0x3030303030303030)) & 0x8080808080808080) == 0;
+}
+
+
+// assumes isEightDigits(v)
+inline uint32_t parseEightDigits(uint64_t v) {
+	const uint64_t mask = 0x000000FF000000FF;
+	const uint64_t mul1 = 0x000F424000000064;	// 100 + (1000000 << 32)
+	const uint64_t mul2 = 0x0000271000000001;	// 1 + (10000 << 32)
+	
+	v -= 0x3030303030303030;
+	v = (v * 10) + (v >> 8);	// the even bytes hold the numbers of 2 digits
+	v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+	return uint32_t(v);
+}
+
+
+// appends the digits at 'first' to 'w' (it can overflow), returns the end of the digits
+inline const char * readDigits(const char * first, const char * last, uint64_t& w) {
+	while (last - first >= 8) {
+		auto v = load8(first);
+		if (!isEightDigits(v)) break;
+		w = w * 100000000 + parseEightDigits(v);
+		first += 8;
+	}
+	
+	while (first != last && isDigit(*first)) {
+		w = w * 10 + uint32_t(*first - '0');
+		first++;
+	}
+	
+	return first;
+}
+
+
+//
+// [-]<digits>
+// Returns the end of the number, or nullptr if there's no digit or the value doesn't fit.
+//
+static const char * convertInt64(const char * first, const char * last, int64_t& value) {
+	bool negative = (first != last) && (*first == '-');
+	first += negative;
+	
+	auto start = first;
+	uint64_t w = 0;
+	first = readDigits(first, last, w);
+	
+	if (first == start) return nullptr;
+	
+	// 19 digits can't overflow w, 20 digits (without the leading zeros) are out of the range
+	if (first - start > 19) {
+		while (start != first && *start == '0') start++;
+		if (first - start > 19) return nullptr;
+	}
+	if (w > uint64_t(INT64_MAX) + negative) return nullptr;
+	
+	value = negative ? int64_t(0 - w) : int64_t(w);
+	return first;
+}
+
+
+//
+// The result of the Eisel-Lemire algorithm: the double is
+// (mantissa + (power2 ? 2^52 : 0)) * 2^(power2 - 1075), power2 == 0x7FF is infinity
+//
+struct binary_float_t {
+	uint64_t mantissa;
+	int32_t power2;
+	
+	bool operator!=(const binary_float_t& o) const { return mantissa != o.mantissa || power2 != o.power2; }
+};
+
+
+//
+// Returns w * 10^q rounded to the nearest double, with ties to even (w < 2^64).
+// It's the algorithm of fast_float (D. Lemire, "Number Parsing at a Gigabyte per Second",
+// 2021) and it's exact: the 128-bit product w * 5^q is always enough to round correctly
+// (N. Mushtak, D. Lemire, "Fast Number Parsing Without Fallback", 2023).
+//
+static binary_float_t computeFloat(int64_t q, uint64_t w) {
+	constexpr int mantissa_bits = 52;
+	constexpr int min_exponent = -1023;
+	constexpr int infinite_power = 0x7FF;
+	constexpr int64_t min_round_even = -4;	// the ties are only possible for q in [-4, 23]
+	constexpr int64_t max_round_even = 23;
+	
+	binary_float_t r;
+	if (w == 0 || q < pow5_min_exponent) {
+		r.mantissa = 0;
+		r.power2 = 0;
+		return r;
+	}
+	
+	if (q > pow5_max_exponent) {
+		r.mantissa = 0;
+		r.power2 = infinite_power;
+		return r;
+	}
+	
+	// w normalized so that its high bit is set, times the power of 5
+	auto lz = countLeadingZeros64(w);
+	w <<= lz;
+	
+	auto index = 2 * size_t(q - pow5_min_exponent);
+	auto product = multiply64(w, pow5_128[index]);
+	
+	// the low bits of the high word would be all 1s if the second word had a carry
+	constexpr uint64_t precision_mask = UINT64_MAX >> (mantissa_bits + 3);
+	if ((product.high & precision_mask) == precision_mask) {
+		auto second = multiply64(w, pow5_128[index + 1]);
+		product.low += second.high;
+		if (second.high > product.low) product.high++;
+	}
+	
+	int upper = int(product.high >> 63);
+	r.mantissa = product.high >> (upper + 64 - mantissa_bits - 3);
+	
+	// floor(log2(10^q)) + 63 + 1023 - lz, with floor(log2(10^q)) = (217706 * q) >> 16
+	r.power2 = int32_t(((int64_t(217706) * q) >> 16) + 63) + upper - int32_t(lz) - min_exponent;
+	
+	if (r.power2 <= 0) {
+		// subnormal, or 0 if the result is more than 64 bits below the smallest exponent
+		if (-r.power2 + 1 >= 64) {
+			r.mantissa = 0;
+			r.power2 = 0;
+			return r;
 		}
 		
-		// these values should have been escaped
-		if ((uint8_t)c < 0x20) return parse_error(p, Invalid_char, first);
+		r.mantissa >>= -r.power2 + 1;
+		r.mantissa += (r.mantissa & 1);	// round up
+		r.mantissa >>= 1;
+		
+		// the rounding can make the smallest normal number from the largest subnormal
+		r.power2 = (r.mantissa < (uint64_t(1) << mantissa_bits)) ? 0 : 1;
+		return r;
 	}
 	
-	for (;first != last; ++first) {
-		c = *first;
-		// end of string
-		if (c == '"') {
-			p.parsed = first+1;
-			return call_string_callback(p, start, cur, report_type);
+	// exactly halfway between two doubles (the lower bits are 0): round to even
+	if (product.low <= 1 && q >= min_round_even && q <= max_round_even &&
+		(r.mantissa & 3) == 1 && (r.mantissa << (upper + 64 - mantissa_bits - 3)) == product.high) {
+		r.mantissa &= ~uint64_t(1);
+	}
+	
+	r.mantissa += (r.mantissa & 1);	// round up
+	r.mantissa >>= 1;
+	
+	// the rounding overflowed to the next power of 2
+	if (r.mantissa >= (uint64_t(2) << mantissa_bits)) {
+		r.mantissa = uint64_t(1) << mantissa_bits;
+		r.power2++;
+	}
+	
+	r.mantissa &= ~(uint64_t(1) << mantissa_bits);
+	if (r.power2 >= infinite_power) {
+		r.mantissa = 0;
+		r.power2 = infinite_power;
+	}
+	
+	return r;
+}
+
+
+static const double exact_powers_of_ten[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+
+//
+// [-]<digits>[.[<digits>]][(e|E)[+|-]<digits>], as std::from_chars in the general format:
+// the exponent is part of the number only if it has digits.
+// Returns the end of the number, or nullptr if there's no digit or the value is out of the
+// double range (infinity, or 0 for a number which is not 0).
+//
+static const char * convertDouble(const char * first, const char * last, double& value) {
+	auto start = first;
+	bool negative = (first != last) && (*first == '-');
+	first += negative;
+	
+	// the first 19 digits fit in w, then w is wrong but it's not used (see 'truncated')
+	uint64_t w = 0;
+	auto int_first = first;
+	first = readDigits(first, last, w);
+	auto int_last = first;
+	int64_t digits = int_last - int_first;
+	
+	int64_t q = 0;
+	const char * frac_first = first;
+	const char * frac_last = first;
+	if (first != last && *first == '.') {
+		frac_first = ++first;
+		first = readDigits(first, last, w);
+		frac_last = first;
+		q = frac_first - frac_last;
+		digits += frac_last - frac_first;
+	}
+	
+	if (digits == 0) return nullptr;
+	
+	if (first != last && (*first | 0x20) == 'e') {
+		auto exp = first + 1;
+		bool exp_negative = false;
+		if (exp != last && (*exp == '-' || *exp == '+')) {
+			exp_negative = (*exp == '-');
+			exp++;
 		}
 		
-		// copy normal character
-		if (c != '\\') {
-			// these values should have been escaped
-			if ((uint8_t)c < 0x20) return parse_error(p, Invalid_char, first);
-			
-			*cur++ = c;
-			continue;
+		if (exp != last && isDigit(*exp)) {
+			int64_t e = 0;
+			for (; exp != last && isDigit(*exp); ++exp) {
+				if (e < 0x10000) e = e * 10 + (*exp - '0');
+			}
+			q += exp_negative ? -e : e;
+			first = exp;
+		}
+	}
+	
+	//
+	// More than 19 digits: w is the first 19 significant digits (the leading zeros are not
+	// significant) and the number is between w and w+1 (times the power of 10)
+	//
+	bool truncated = false;
+	if (digits > 19) {
+		auto p = int_first;
+		while (p != frac_last && (*p == '0' || *p == '.')) {
+			if (*p == '0') digits--;
+			p++;
 		}
-
-_escape_seq:
-		// process escape sequence
-		first++;
-		if (first == last) return parse_error(p, No_string_end, start-1);
 		
-		c = *first;
-		if (c != 'u') {
-			if ((c == '"') | (c == '\\') | (c == '/')) {
-				*cur = c;
-			}
-			else if (c == 'n') {
-				*cur = '\n';
-			}
-			else if (c == 'r') {
-				*cur = '\r';
-			}
-			else if (c == 't') {
-				*cur = '\t';
-			}
-			else if (c == 'b') {
-				*cur = '\b';
-			}
-			else if (c == 'f') {
-				*cur = '\f';
+		if (digits > 19) {
+			truncated = true;
+			int64_t exp = q + (frac_last - frac_first);	// the exponent without the fraction
+			
+			const uint64_t min_19_digits = 1000000000000000000;
+			w = 0;
+			p = int_first;
+			while (w < min_19_digits && p != int_last) w = w * 10 + uint32_t(*p++ - '0');
+			
+			if (w >= min_19_digits) {
+				q = exp + (int_last - p);
 			}
 			else {
-				return parse_error(p, Invalid_escape, first);
-			}
-			
-			cur++;
-		}
-		else {
-			if (!unescapeUnicodeChar(p, first+1, last, &cur)) {
-				return false;
+				p = frac_first;
+				while (w < min_19_digits && p != frac_last) w = w * 10 + uint32_t(*p++ - '0');
+				q = exp - (p - frac_first);
 			}
-			
-			first = p.parsed - 1; // - 1 is needed for the increment of the for loop
 		}
 	}
 	
-	return parse_error(p, No_string_end, start-1);
+	// Clinger: w and 10^|q| are exact doubles, the result of one operation is rounded correctly
+	if (!truncated && w <= (uint64_t(1) << 53) && q >= -22 && q <= 22) {
+		double d = double(w);
+		d = (q < 0) ? d / exact_powers_of_ten[-q] : d * exact_powers_of_ten[q];
+		value = negative ? -d : d;
+		return first;
+	}
+	
+	auto r = computeFloat(q, w);
+	if (truncated && r != computeFloat(q, w + 1)) {
+		auto res = std::from_chars(start, first, value);
+		return (res.ec == std::errc()) ? res.ptr : nullptr;
+	}
+	
+	// out of range, as std::from_chars
+	if (r.power2 == 0x7FF || (r.power2 == 0 && r.mantissa == 0 && w != 0)) return nullptr;
+	
+	uint64_t bits = r.mantissa | (uint64_t(r.power2) << 52) | (uint64_t(negative) << 63);
+	memcpy(&value, &bits, sizeof(value));
+	return first;
+}
+
+#else
+
+static const char * convertInt64(const char * first, const char * last, int64_t& value) {
+	auto res = std::from_chars(first, last, value);
+	return (res.ec == std::errc()) ? res.ptr : nullptr;
+}
+
+
+static const char * convertDouble(const char * first, const char * last, double& value) {
+	auto res = std::from_chars(first, last, value);
+	return (res.ec == std::errc()) ? res.ptr : nullptr;
 }
 
+#endif // AZP_JSON_FROM_CHARS
 
-// assumes last == first + max_len + 1 (see parseNumber)
-// 'max_len' is the longest string for floating numbers accepted
+
+constexpr size_t max_number_len = 24; // longest valid long long string "-9223372036854775807" (19+1)
+                                      // longest valid double string "-1.1111111111111112e+300" (24)
+
+
+// assumes last == first + max_number_len + 1 (see parseNumber)
+// The chars are scanned in a copy ended by a sentinel: the buffer isn't written, the pages
+// of a file mapped copy-on-write are not copied for the numbers (see json_read_file).
 static bool parseNumberNoCopy(parser_base_t& p, char * first, char * last) {
+	char buf[max_number_len + 1];
+	memcpy(buf, first, max_number_len);
+	buf[max_number_len] = 0; // sentinel, at last-1
+	(void)last;
+	
 	char * savedFirst = first;
-		
-	auto savedCh = *(last-1);
-	*(last-1) = 0; // sentinel
+	first = buf;
 	
 	// optional '-' sign
 	if (*first == '-') {
@@ -398,28 +879,26 @@ static bool parseNumberNoCopy(parser_base_t& p, char * first, char * last) {
 		}
 	}
 	
-	*(last-1) = savedCh;	// replace the sentinel with the saved character
-	
 	bool result;
 	if (haveDot | haveExp) {		
 		value_t val;
-		auto res = std::from_chars(savedFirst, first, val.number);
-		if (res.ec != std::errc()) {
+		auto end = convertDouble(buf, first, val.number);
+		if (!end) {
 			return parse_error(p, Invalid_number, savedFirst);
 		}
 		
 		result = wrap_user_callback(Number_float, val, savedFirst);
-		first = (char *)res.ptr;
+		first = savedFirst + (end - buf);
 	}
 	else {
 		value_t val;
-		auto res = std::from_chars(savedFirst, first, val.integer);
-		if (res.ec != std::errc()) {
+		auto end = convertInt64(buf, first, val.integer);
+		if (!end) {
 			return parse_error(p, Invalid_number, savedFirst);
 		}
 		
 		result = wrap_user_callback(Number_int, val, savedFirst);
-		first = (char *)res.ptr;
+		first = savedFirst + (end - buf);
 	}
 	
 	p.parsed = first;
@@ -429,8 +908,7 @@ static bool parseNumberNoCopy(parser_base_t& p, char * first, char * last) {
 
 // assumes first != last
 static bool parseNumber(parser_base_t& p, char * first, char * last) {
-	constexpr size_t max_len = 24; // longest valid long long string "-9223372036854775807" (19+1)
-	                               // longest valid double string "-1.1111111111111112e+300" (24)
+	constexpr size_t max_len = max_number_len;
 	
 	if (last - first > max_len) {
 		// adjust last so that we don't attempt to parse more than the buffer size
@@ -511,23 +989,23 @@ static bool parseNumber(parser_base_t& p, char * first, char * last) {
 	bool result;
 	if (haveDot | haveExp) {		
 		value_t val;
-		auto res = std::from_chars(buf, std::end(buf), val.number);
-		if (res.ec != std::errc()) {
+		auto end = convertDouble(buf, buf + cur, val.number);
+		if (!end) {
 			return parse_error(p, Invalid_number, savedFirst);
 		}
 		
 		result = wrap_user_callback(Number_float, val, savedFirst);
-		first = res.ptr - buf + savedFirst;
+		first = end - buf + savedFirst;
 	}
 	else {
 		value_t val;
-		auto res = std::from_chars(buf, std::end(buf), val.integer);
-		if (res.ec != std::errc()) {
+		auto end = convertInt64(buf, buf + cur, val.integer);
+		if (!end) {
 			return parse_error(p, Invalid_number, savedFirst);
 		}
 		
 		result = wrap_user_callback(Number_int, val, savedFirst);
-		first = res.ptr - buf + savedFirst;
+		first = end - buf + savedFirst;
 	}
 	
 	p.parsed = first;
@@ -701,5 +1179,911 @@ static bool parseJsonArray(parser_base_t& p, char * first, char * last) {
 }
 
 
+//
+// Bit masks of 64 chars (skipCollection): the quotes, backslashes and brackets of a block
+// are compared with SIMD and moved to the bits of a 64 bit word. The escaped chars and
+// the chars inside strings are computed from them without branches.
+//
+
+inline uint32_t countTrailingZeros64(uint64_t mask) {
+#if defined(_MSC_VER)
+	unsigned long pos;
+	if (_BitScanForward(&pos, uint32_t(mask))) return pos;
+	_BitScanForward(&pos, uint32_t(mask >> 32));
+	return pos + 32;
+#else
+	return __builtin_ctzll(mask);
+#endif
+}
+
+
+inline uint32_t popCount64(uint64_t x) {
+#if defined(_MSC_VER)
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return uint32_t((x * 0x0101010101010101ULL) >> 56);
+#else
+	return __builtin_popcountll(x);
+#endif
+}
+
+
+// bit i of the result is the xor of the bits 0..i
+inline uint64_t prefixXor(uint64_t x) {
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
+}
+
+
+inline bool isWspace(char c) {
+	return (c == ' ') | (c == '\n') | (c == '\r') | (c == '\t');
+}
+
+
+//
+// Returns the chars preceded by an odd number of backslashes. The runs of backslashes
+// are found with a carry propagating addition.
+//
+AZP_FORCE_INLINE uint64_t findEscaped(uint64_t backslash, uint64_t& prev_escaped) {
+	const uint64_t even_bits = 0x5555555555555555ULL;
+	
+	backslash &= ~prev_escaped;
+	uint64_t follows_escape = (backslash << 1) | prev_escaped;
+	
+	// runs starting on odd bits, added to the backslashes, carry to the end of the run
+	uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+	uint64_t sequences_on_even = odd_starts + backslash;
+	prev_escaped = (sequences_on_even < odd_starts) ? 1 : 0;
+	
+	uint64_t invert_mask = sequences_on_even << 1;
+	return (even_bits ^ invert_mask) & follows_escape;
+}
+
+
+AZP_FORCE_INLINE uint32_t popLowestBit(uint64_t& bits) {
+	auto i = countTrailingZeros64(bits | (uint64_t(1) << 63));	// the count of trailing zeros of 0 is undefined
+	bits &= bits - 1;
+	return i;
+}
+
+
+#if defined(AZP_JSON_SIMD)
+
+inline uint64_t movemask64(__m128i v0, __m128i v1, __m128i v2, __m128i v3) {
+	return uint64_t(uint32_t(_mm_movemask_epi8(v0)))
+		| (uint64_t(uint32_t(_mm_movemask_epi8(v1))) << 16)
+		| (uint64_t(uint32_t(_mm_movemask_epi8(v2))) << 32)
+		| (uint64_t(uint32_t(_mm_movemask_epi8(v3))) << 48);
+}
+
+#endif // AZP_JSON_SIMD
+
+
+
+//
+// On-demand extraction (extractJson)
+//
+// The values are matched against the tree of the paths: each value has the set of the
+// nodes which lead to it, a stack of sets in 'sets' (the set of a value follows the set
+// of its parent). A value without nodes is skipped: the strings up to the closing quote
+// (findStringSpecial), the numbers and literals up to a delimiter, the objects and arrays
+// up to the matching bracket (skipCollection).
+//
+
+struct extract_ctx_t {
+	const json_paths_t::node_t * nodes;
+	path_callback_t callback;
+	void * context;
+	std::vector<uint32_t> sets;
+	std::vector<char> found;	// the paths already reported, when there's no '*'
+	uint32_t remaining;			// the paths not found yet, when there's no '*'
+	ParserTypes type;			// the last value parsed (extract_callback)
+	value_t value;
+};
+
+
+// the parser's callback: keeps the value, the keys and the scalars are parsed by parseJson's functions
+static bool extract_callback(void * ctx, ParserTypes type, const value_t& val) {
+	auto& x = *(extract_ctx_t *)ctx;
+	x.type = type;
+	x.value = val;
+	return true;
+}
+
+
+json_paths_t::json_paths_t() : _nodes(1), _paths(0), _wildcards(false) {
+	_nodes[0].index = none;
+	_nodes[0].child = 0;
+	_nodes[0].next = 0;
+	_nodes[0].path = none;
+	_nodes[0].wildcard = false;
+}
+
+
+uint32_t json_paths_t::add(const std::string& path) {
+	uint32_t node = 0;
+	size_t pos = (!path.empty() && path[0] == '/') ? 1 : 0;
+	
+	while (pos <= path.size() && !path.empty()) {
+		auto end = std::min(path.find('/', pos), path.size());
+		
+		std::string key;
+		for (auto i = pos; i < end; ++i) {
+			if (path[i] == '~' && i+1 < end && (path[i+1] == '0' || path[i+1] == '1')) {
+				key += (path[++i] == '0') ? '~' : '/';
+			}
+			else key += path[i];
+		}
+		pos = end + 1;
+		
+		auto child = _nodes[node].child;
+		while (child && _nodes[child].key != key) child = _nodes[child].next;
+		
+		if (!child) {
+			node_t n;
+			n.index = none;
+			n.child = 0;
+			n.next = _nodes[node].child;
+			n.path = none;
+			n.wildcard = (key == "*");
+			
+			// no leading zeros, like the array indexes of a JSON pointer
+			if (!key.empty() && key.size() < 10 && key.find_first_not_of("0123456789") == std::string::npos &&
+				(key[0] != '0' || key.size() == 1)) {
+				n.index = uint32_t(std::stoul(key));
+			}
+			
+			n.key = std::move(key);
+			child = uint32_t(_nodes.size());
+			_wildcards |= n.wildcard;
+			_nodes.push_back(std::move(n));
+			_nodes[node].child = child;
+		}
+		
+		node = child;
+	}
+	
+	if (_nodes[node].path == none) _nodes[node].path = _paths++;
+	return _nodes[node].path;
+}
+
+
+// the quotes, the backslashes and the brackets of a block of 64 chars
+struct skip_masks_t {
+	uint64_t quote;
+	uint64_t backslash;
+	uint64_t open;		// '{', '['
+	uint64_t close;		// '}', ']'
+};
+
+
+#if defined(AZP_JSON_SIMD)
+
+static AZP_FORCE_INLINE skip_masks_t skipMasks(const char * s) {
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i bslash = _mm_set1_epi8('\\');
+	const __m128i open = _mm_set1_epi8('{');
+	const __m128i close = _mm_set1_epi8('}');
+	const __m128i lower = _mm_set1_epi8(0x20);
+	
+	__m128i v0 = _mm_loadu_si128((const __m128i*)s);
+	__m128i v1 = _mm_loadu_si128((const __m128i*)(s+16));
+	__m128i v2 = _mm_loadu_si128((const __m128i*)(s+32));
+	__m128i v3 = _mm_loadu_si128((const __m128i*)(s+48));
+	
+	// '[' and ']' | 0x20 are '{' and '}'
+	__m128i l0 = _mm_or_si128(v0, lower), l1 = _mm_or_si128(v1, lower), l2 = _mm_or_si128(v2, lower), l3 = _mm_or_si128(v3, lower);
+	
+	skip_masks_t m;
+	m.quote = movemask64(_mm_cmpeq_epi8(v0, quote), _mm_cmpeq_epi8(v1, quote), _mm_cmpeq_epi8(v2, quote), _mm_cmpeq_epi8(v3, quote));
+	m.backslash = movemask64(_mm_cmpeq_epi8(v0, bslash), _mm_cmpeq_epi8(v1, bslash), _mm_cmpeq_epi8(v2, bslash), _mm_cmpeq_epi8(v3, bslash));
+	m.open = movemask64(_mm_cmpeq_epi8(l0, open), _mm_cmpeq_epi8(l1, open), _mm_cmpeq_epi8(l2, open), _mm_cmpeq_epi8(l3, open));
+	m.close = movemask64(_mm_cmpeq_epi8(l0, close), _mm_cmpeq_epi8(l1, close), _mm_cmpeq_epi8(l2, close), _mm_cmpeq_epi8(l3, close));
+	return m;
+}
+
+#else
+
+static skip_masks_t skipMasks(const char * s) {
+	skip_masks_t m = {};
+	
+	for (int i=0; i<64; ++i) {
+		auto c = s[i];
+		auto bit = uint64_t(1) << i;
+		
+		if (c == '"') m.quote |= bit;
+		else if (c == '\\') m.backslash |= bit;
+		else if ((c == '{') | (c == '[')) m.open |= bit;
+		else if ((c == '}') | (c == ']')) m.close |= bit;
+	}
+	return m;
+}
+
+#endif // AZP_JSON_SIMD
+
+
+//
+// Skips the object or the array at 'first', 64 chars at a time: the strings are found with
+// the bit masks above and the brackets outside of them are counted.
+// A block with less closing brackets than the depth doesn't end the value, its brackets
+// are counted with popCount64, the others are looked at one by one.
+// Returns the position after the closing bracket, or nullptr.
+//
+static char * skipCollection(char * first, char * last) {
+	uint64_t prev_escaped = 0;
+	uint64_t prev_in_string = 0;
+	uint64_t depth = 0;
+	char tail[64];
+	
+	for (auto cur = first; cur < last; cur += 64) {
+		auto s = (const char *)cur;
+		
+		// the last block is padded with spaces
+		if (last - cur < 64) {
+			memset(tail, ' ', sizeof(tail));
+			memcpy(tail, cur, last - cur);
+			s = tail;
+		}
+		
+		auto m = skipMasks(s);
+		uint64_t quote = m.quote & ~findEscaped(m.backslash, prev_escaped);
+		uint64_t in_string = prefixXor(quote) ^ prev_in_string;
+		prev_in_string = uint64_t(int64_t(in_string) >> 63);
+		
+		uint64_t open = m.open & ~in_string;
+		uint64_t close = m.close & ~in_string;
+		
+		auto closes = popCount64(close);
+		if (closes < depth) {
+			depth = depth + popCount64(open) - closes;
+			continue;
+		}
+		
+		for (auto brackets = open | close; brackets; ) {
+			auto i = popLowestBit(brackets);
+			if (open & (uint64_t(1) << i)) depth++;
+			else if (--depth == 0) return cur + i + 1;
+		}
+	}
+	
+	return nullptr;
+}
+
+
+// assumes that '"' was already parsed; returns the position after the closing quote, or nullptr
+static char * skipString(char * first, char * last) {
+	for (;;) {
+		first = findStringSpecial(first, last);
+		if (first == last) return nullptr;
+		if (*first == '"') return first + 1;
+		
+		if (*first == '\\') {
+			if (last - first < 2) return nullptr;
+			first += 2;
+		}
+		else ++first;	// a control char, not validated
+	}
+}
+
+
+// skips the value at 'first' (not whitespace)
+static bool skipValue(parser_base_t& p, char * first, char * last) {
+	auto chr = *first;
+	
+	if (chr == '"') {
+		p.parsed = skipString(first+1, last);
+		return p.parsed ? true : parse_error(p, No_string_end, first);
+	}
+	
+	if ((chr != '{') & (chr != '[')) {
+		// a number or a literal, up to the delimiter
+		auto cur = first;
+		while (cur != last && !isWspace(*cur) && (*cur != ',') & ((*cur | 0x20) != '}')) ++cur;
+		
+		if (cur == first) return parse_error(p, No_value, first);
+		p.parsed = cur;
+		return true;
+	}
+	
+	p.parsed = skipCollection(first, last);
+	return p.parsed ? true : parse_error(p, Unbalanced_collection, first);
+}
+
+
+static bool extractValue(parser_base_t& p, extract_ctx_t& x, size_t set_first, char * first, char * last);
+
+
+// pushes the children of the set [set_first, set_last) which match the key or the index
+static void matchChildren(extract_ctx_t& x, size_t set_first, size_t set_last, const value_t * key, uint32_t index) {
+	for (auto i = set_first; i < set_last; ++i) {
+		for (auto c = x.nodes[x.sets[i]].child; c; c = x.nodes[c].next) {
+			auto& n = x.nodes[c];
+			
+			bool match = n.wildcard;
+			if (key) match |= n.key.size() == key->string.len && memcmp(n.key.data(), key->string.p, key->string.len) == 0;
+			else match |= n.index == index;
+			
+			if (match) x.sets.push_back(c);
+		}
+	}
+}
+
+
+// the value at 'first' (not whitespace) matched the set of nodes [set_first, set_last), without the children
+static bool extractChild(parser_base_t& p, extract_ctx_t& x, size_t set_first, char * first, char * last) {
+	bool result = (x.sets.size() == set_first) ? skipValue(p, first, last) : extractValue(p, x, set_first, first, last);
+	x.sets.resize(set_first);
+	return result;
+}
+
+
+// assumes that '{' was already parsed
+static bool extractObject(parser_base_t& p, extract_ctx_t& x, size_t set_first, size_t set_last, char * first, char * last) {
+	first = skip_wspace(first, last);
+	if (first == last) return parse_error(p, Unbalanced_collection, first);
+	
+	if (*first == '}') {
+		p.parsed = first + 1;
+		return true;
+	}
+	
+	for (;;) {
+		// name, unescaped in place if needed
+		if (*first != '"') return parse_error(p, Expected_key, first);
+		
+		value_t key;
+		auto end = findStringSpecial(first+1, last);
+		if (end != last && *end == '"') {
+			key.string.p = first+1;
+			key.string.len = end - (first+1);
+			p.parsed = end+1;
+		}
+		else {
+			if (!parseString(p, first+1, last, Object_key)) return parse_error(p, No_value, first);
+			key = x.value;
+		}
+		
+		first = skip_wspace(p.parsed, last);
+		if (first == last || *first != ':') return parse_error(p, Expected_colon, first);
+		
+		// value
+		first = skip_wspace(first+1, last);
+		if (first == last) return parse_error(p, No_value, first);
+		
+		auto child_first = x.sets.size();
+		matchChildren(x, set_first, set_last, &key, 0);
+		if (!extractChild(p, x, child_first, first, last)) return false;
+		if (x.remaining == 0) return true;
+		
+		first = skip_wspace(p.parsed, last);
+		if (first == last) return parse_error(p, Unbalanced_collection, first);
+
+		if (*first == ',') {
+			first = skip_wspace(first+1, last);
+			if (first == last) return parse_error(p, Expected_key, first);
+		}
+		else break;
+	}
+	
+	if (*first == '}') {
+		p.parsed = first + 1;
+		return true;
+	}
+	
+	return parse_error(p, Unbalanced_collection, first);
+}
+
+
+// assumes that '[' was already parsed
+static bool extractArray(parser_base_t& p, extract_ctx_t& x, size_t set_first, size_t set_last, char * first, char * last) {
+	first = skip_wspace(first, last);
+	if (first == last) return parse_error(p, Unbalanced_collection, first);
+	
+	if (*first == ']') {
+		p.parsed = first + 1;
+		return true;
+	}
+	
+	for (uint32_t index = 0; ; ++index) {
+		// value
+		auto child_first = x.sets.size();
+		matchChildren(x, set_first, set_last, nullptr, index);
+		if (!extractChild(p, x, child_first, first, last)) return false;
+		if (x.remaining == 0) return true;
+		 
+		first = skip_wspace(p.parsed, last);
+		if (first == last) return parse_error(p, Unbalanced_collection, first);
+
+		if (*first == ',') {
+			first = skip_wspace(first+1, last);
+			if (first == last) return parse_error(p, No_value, first);
+		}
+		else break;
+	}
+	
+	if (*first == ']') {
+		p.parsed = first + 1;
+		return true;
+	}
+	
+	return parse_error(p, Unbalanced_collection, first);
+}
+
+
+// reports the value at 'first' (not whitespace) to the paths which end in the set
+static bool reportValue(parser_base_t& p, extract_ctx_t& x, size_t set_first, size_t set_last, char * first, char * last) {
+	bool parsed = false;
+	
+	for (auto i = set_first; i < set_last; ++i) {
+		auto path = x.nodes[x.sets[i]].path;
+		if (path == json_paths_t::none) continue;
+		
+		if (x.found.size()) {
+			if (x.found[path]) continue;
+			x.found[path] = 1;
+			x.remaining--;
+		}
+		
+		// parsed once for all the paths, the strings are unescaped in place
+		if (!parsed) {
+			auto chr = *first;
+			if ((chr == '{') | (chr == '[')) {
+				if (!skipValue(p, first, last)) return false;
+				x.type = (chr == '{') ? Object_begin : Array_begin;
+				x.value.string.p = first;
+				x.value.string.len = p.parsed - first;
+			}
+			else if (!parseJsonScalarV(p, first, last)) return false;
+			
+			parsed = true;
+		}
+		
+		if (!x.callback(x.context, path, x.type, x.value)) return parse_error(p, User_requested, p.parsed);
+	}
+	
+	return true;
+}
+
+
+// the value at 'first' matched the set of nodes which begins at 'set_first'
+static bool extractValue(parser_base_t& p, extract_ctx_t& x, size_t set_first, char * first, char * last) {
+	if (++p.recursion >= p.max_recursion) return parse_error(p, Max_recursion, first);
+	
+	dec_on_exit de(p.recursion);
+	
+	first = skip_wspace(first, last);
+	if (first == last) return parse_error(p, No_value, first);
+	
+	auto set_last = x.sets.size();
+	p.parsed = first;
+	if (!reportValue(p, x, set_first, set_last, first, last)) return false;
+	if (x.remaining == 0) return true;
+	
+	// the objects and arrays are read again for the children
+	bool children = false;
+	for (auto i = set_first; i < set_last; ++i) children |= x.nodes[x.sets[i]].child != 0;
+	
+	auto chr = *first;
+	if (children && chr == '{') return extractObject(p, x, set_first, set_last, first+1, last);
+	if (children && chr == '[') return extractArray(p, x, set_first, set_last, first+1, last);
+	
+	// reported or skipped
+	return (p.parsed != first) || skipValue(p, first, last);
+}
+
+
+static bool extractRoot(parser_base_t& p, char * first, char * last) {
+	auto& x = *(extract_ctx_t *)p.context;
+	
+	x.sets.push_back(0);
+	return extractValue(p, x, 0, first, last);
+}
+
+
+bool extractJson(parser_t& p, const json_paths_t& paths, char * first, char * last,
+				 path_callback_t callback, void * context)
+{
+	extract_ctx_t x;
+	x.nodes = paths._nodes.data();
+	x.callback = callback;
+	x.context = context;
+	x.sets.reserve(64);
+	x.remaining = json_paths_t::none;	// never 0
+	
+	if (!paths._wildcards && paths._paths) {
+		x.found.resize(paths._paths);
+		x.remaining = paths._paths;
+	}
+	
+	p.set_callback(&extract_callback, &x);
+	return parseBuffer(p, first, last, &extractRoot);
+}
+
+
+//
+// Push parser (stream_parser_t)
+//
+// A state machine over the chunks for the structure; the strings and the scalars are parsed
+// by the functions above. A string which is entirely in the chunk and has no escapes is
+// reported from the chunk, the others are copied to 'token' up to the closing quote.
+// The scalars are always copied: only the first 25 chars decide the value (see parseNumber),
+// so a scalar is cut at 'max_scalar' chars and the rest is reported as garbage.
+//
+
+constexpr size_t max_scalar = 32;
+constexpr size_t string_padding = 8;	// chars following the closing quote, see endString
+
+
+inline bool isDelimiter(char c) {
+	return isWspace(c) | (c == ',') | (c == ':') | (c == '[') | (c == ']') | (c == '{') | (c == '}') | (c == '"');
+}
+
+
+stream_parser_t::stream_parser_t() {
+	callback = [](void*, ParserTypes, const value_t&) { return true; };
+	context = nullptr;
+	max_recursion = 16;
+	reset();
+}
+
+
+void stream_parser_t::reset() {
+	parsed = nullptr;
+	recursion = 0;
+	error = No_error;
+	err_position = 0;
+	_first = nullptr;
+	parsed_offset = 0;
+	
+	stack.clear();
+	token.clear();
+	saved.clear();
+	chunk = nullptr;
+	offset = 0;
+	token_offset = 0;
+	value_offset = 0;
+	lookahead = 0;
+	state = Value;
+	key = false;
+	escape = false;
+}
+
+
+bool stream_parser_t::streamError(ParserErrors err, size_t pos) {
+	error = err;
+	err_position = pos;
+	state = Failed;
+	return false;
+}
+
+
+bool stream_parser_t::parse(const char * first, const char * last) {
+	if (state == Failed) return false;
+	
+	chunk = first;
+	auto cur = first;
+	bool result = true;
+	
+	while (result && cur != last && state != Done) {
+		if (state == String) result = continueString(cur, last);
+		else if (state == Scalar) result = continueScalar(cur, last);
+		else if (state == String_error) {
+			auto n = std::min<size_t>(lookahead, last - cur);
+			token.append(cur, n);
+			cur += n;
+			lookahead -= n;
+			if (!lookahead) result = stringError();
+		}
+		else if (isWspace(*cur)) ++cur;
+		else result = parseChar(cur, last);
+	}
+	
+	offset += last - first;
+	return result;
+}
+
+
+bool stream_parser_t::finish() {
+	switch (state) {
+	case Done:
+		return true;
+	case Failed:
+		return false;
+	case String:
+		return endString(true);
+	case String_error:
+		return stringError();
+	case Scalar:
+		if (!endScalar(true)) return false;
+		if (state == Done) return true;
+		return streamError(Unbalanced_collection, offset);
+	case Value:
+		if (stack.size() + 1 >= max_recursion) return streamError(Max_recursion, value_offset);
+		return streamError(No_value, offset);
+	case Array_next:
+		return streamError(No_value, offset);
+	case Object_next:
+		return streamError(Expected_key, offset);
+	case Colon:
+		return streamError(Expected_colon, offset);
+	default:
+		return streamError(Unbalanced_collection, offset);
+	}
+}
+
+
+// processes the non-whitespace char at 'cur' between values
+bool stream_parser_t::parseChar(const char *& cur, const char * last) {
+	auto chr = *cur;
+	
+	switch (state) {
+	case Value:
+		return beginValue(cur, last);
+	
+	case Array_first:
+		if (chr == ']') return endCollection(cur);
+		value_offset = chunkOffset(cur);
+		return beginValue(cur, last);
+	
+	case Array_next:
+		value_offset = chunkOffset(cur);
+		return beginValue(cur, last);
+	
+	case Object_first:
+		if (chr == '}') return endCollection(cur);
+		if (chr != '"') return streamError(Expected_key, chunkOffset(cur));
+		key = true;
+		return beginString(cur, last);
+	
+	case Object_next:
+		if (chr != '"') return streamError(Expected_key, chunkOffset(cur));
+		key = true;
+		return beginString(cur, last);
+	
+	case Colon:
+		if (chr != ':') return streamError(Expected_colon, chunkOffset(cur));
+		++cur;
+		value_offset = chunkOffset(cur);
+		state = Value;
+		return true;
+	
+	case After_value:
+		if (chr == ',') {
+			++cur;
+			state = (stack.back() == '[') ? Array_next : Object_next;
+			return true;
+		}
+		if (chr == ((stack.back() == '[') ? ']' : '}')) return endCollection(cur);
+		return streamError(Unbalanced_collection, chunkOffset(cur));
+	
+	default:
+		return streamError(Runtime_error, chunkOffset(cur));	// unreachable
+	}
+}
+
+
+bool stream_parser_t::beginValue(const char *& cur, const char * last) {
+	if (stack.size() + 1 >= max_recursion) return streamError(Max_recursion, value_offset);
+	
+	auto chr = *cur;
+	if ((chr == '{') | (chr == '[')) {
+		++cur;
+		value_t val{};
+		if (!callback(context, (chr == '{') ? Object_begin : Array_begin, val)) {
+			return streamError(User_requested, chunkOffset(cur));
+		}
+		stack += chr;
+		state = (chr == '{') ? Object_first : Array_first;
+		return true;
+	}
+	
+	if (chr == '"') {
+		key = false;
+		return beginString(cur, last);
+	}
+	
+	return beginScalar(cur, last);
+}
+
+
+// 'cur' is at the matching ']' or '}'
+bool stream_parser_t::endCollection(const char *& cur) {
+	auto type = (*cur == ']') ? Array_end : Object_end;
+	++cur;
+	
+	value_t val{};
+	if (!callback(context, type, val)) return streamError(User_requested, chunkOffset(cur));
+	
+	stack.pop_back();
+	return endValue(chunkOffset(cur));
+}
+
+
+bool stream_parser_t::endValue(size_t end_offset) {
+	if (key) {
+		key = false;
+		state = Colon;
+	}
+	else if (stack.empty()) {
+		parsed_offset = end_offset;
+		state = Done;
+	}
+	else {
+		state = After_value;
+	}
+	
+	return true;
+}
+
+
+// 'cur' is at the opening quote
+bool stream_parser_t::beginString(const char *& cur, const char * last) {
+	auto start = cur + 1;
+	token_offset = chunkOffset(start);
+	
+	const char * stop = findStringSpecial(const_cast<char*>(start), const_cast<char*>(last));
+	
+	if (stop != last && *stop == '"') {
+		cur = stop + 1;
+		
+		value_t val;
+		val.string.p = start;
+		val.string.len = stop - start;
+		if (!callback(context, key ? Object_key : String_val, val)) {
+			return key ? streamError(No_value, token_offset-1) : streamError(User_requested, token_offset);
+		}
+		
+		return endValue(chunkOffset(cur));
+	}
+	
+	token.assign(start, stop);
+	escape = false;
+	state = String;
+	cur = stop;
+	return true;
+}
+
+
+// copies the string to 'token' up to the closing quote
+bool stream_parser_t::continueString(const char *& cur, const char * last) {
+	for (;;) {
+		if (escape) {
+			if (cur == last) return true;
+			token += *cur++;
+			escape = false;
+		}
+		
+		const char * stop = findStringSpecial(const_cast<char*>(cur), const_cast<char*>(last));
+		token.append(cur, stop);
+		cur = stop;
+		if (cur == last) return true;
+		
+		auto chr = *cur++;
+		token += chr;
+		
+		if (chr == '"') return endString(false);
+		if (chr == '\\') escape = true;
+		// the control chars are reported by parseString
+	}
+}
+
+
+bool stream_parser_t::endString(bool at_end) {
+	auto len = token.size();
+	
+	// The position of an invalid '\u' escape which reaches the closing quote depends on
+	// the number of chars which follow it in the document (see unescapeUnicodeChar).
+	// The string is parsed with a padding which stands for these chars, but if it fails
+	// it's parsed again when up to 'string_padding' chars following it are known.
+	bool unicode_end = !key && !at_end && token.find("\\u", (len > 14) ? len - 14 : 0) != std::string::npos;
+	if (unicode_end) saved = token;
+	
+	if (!at_end) token.append(string_padding, ' ');
+	
+	auto first = &token[0];
+	_first = first;
+	
+	bool result = parseString(*this, first, first + token.size(), key ? Object_key : String_val);
+	token.clear();
+	
+	if (!result) {
+		if (key) return streamError(No_value, token_offset-1);
+		
+		if (unicode_end && error == Invalid_escape) {
+			token.swap(saved);
+			lookahead = string_padding;
+			state = String_error;
+			return true;
+		}
+		
+		return streamError(error, err_position + token_offset);	// the position is relative to 'token'
+	}
+	
+	return endValue(token_offset + len);
+}
+
+
+// parses again the string in 'token' followed by the next chars of the document, it fails again
+bool stream_parser_t::stringError() {
+	auto first = &token[0];
+	_first = first;
+	
+	parseString(*this, first, first + token.size(), String_val);
+	return streamError(error, err_position + token_offset);
+}
+
+
+// 'cur' is at the first char of a number or of a literal (or of an invalid value)
+bool stream_parser_t::beginScalar(const char *& cur, const char * last) {
+	token_offset = chunkOffset(cur);
+	
+	// a delimiter isn't the start of a value, the error is reported by parseJsonScalarV
+	auto stop = cur + 1;
+	bool delimiter = isDelimiter(*cur);
+	if (!delimiter) {
+		auto max_stop = cur + std::min<size_t>(last - cur, max_scalar);
+		while (stop != max_stop && !isDelimiter(*stop)) ++stop;
+	}
+	
+	if (stop == last && !delimiter && size_t(stop - cur) < max_scalar) {
+		token.assign(cur, stop);	// it may continue in the next chunk
+		cur = stop;
+		state = Scalar;
+		return true;
+	}
+	
+	// the common case: the scalar ends in the chunk, it's copied on the stack
+	char buf[max_scalar + 1];
+	size_t len = stop - cur;
+	memcpy(buf, cur, len);
+	cur = stop;
+	return parseScalar(buf, len, false);
+}
+
+
+bool stream_parser_t::continueScalar(const char *& cur, const char * last) {
+	auto stop = cur;
+	auto max_stop = cur + std::min<size_t>(last - cur, max_scalar - token.size());
+	while (stop != max_stop && !isDelimiter(*stop)) ++stop;
+	
+	token.append(cur, stop);
+	cur = stop;
+	
+	if (cur != last || token.size() == max_scalar) return endScalar(false);
+	return true;
+}
+
+
+bool stream_parser_t::endScalar(bool at_end) {
+	auto len = token.size();
+	token += ' ';
+	bool result = parseScalar(&token[0], len, at_end);
+	token.clear();
+	return result;
+}
+
+
+// parses the scalar in [first, first+len), the buffer has room for one more char
+bool stream_parser_t::parseScalar(char * first, size_t len, bool at_end) {
+	// the delimiter which follows the value, like in the document (see parseNumber)
+	auto last = first + len;
+	if (!at_end) *last++ = ' ';
+	
+	_first = first;
+	if (!parseJsonScalarV(*this, first, last)) return streamError(error, err_position + token_offset);
+	
+	// garbage after the value
+	size_t used = parsed - first;
+	if (used < len && !stack.empty()) return streamError(Unbalanced_collection, token_offset + used);
+	
+	return endValue(token_offset + used);
+}
+
 } // namespace azp
 
@@ -1,12 +1,16 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
 
 
 namespace azp {
 	
 	
 class parser_t;
+class json_paths_t;
 
 
 //
@@ -80,6 +84,14 @@ union value_t {
 //
 typedef bool (* parser_callback_t)(void * context, ParserTypes type, const value_t& val);
 
+//
+// Called for each value found at a path, with the index of the path in json_paths_t.
+// The strings, numbers and literals are reported as with parseJson. The objects and
+// arrays are reported as Object_begin or Array_begin, val.string is their JSON text.
+// Return 'true' to continue and 'false' to abort.
+//
+typedef bool (* path_callback_t)(void * context, uint32_t path, ParserTypes type, const value_t& val);
+
 
 //
 // Internal structure: holds the parser data
@@ -132,6 +144,167 @@ public:
 
 	friend bool parseJson(parser_t& p, char * first, char * last);
 	friend bool parseJson(parser_t& p, const char * first, const char * last);
+	friend bool extractJson(parser_t& p, const json_paths_t& paths, char * first, char * last,
+							path_callback_t callback, void * context);
+};
+
+
+//
+// The paths of the values wanted from a document, @see extractJson.
+//
+// A path is a list of keys like a JSON pointer (RFC 6901): "/user/id", "/items/0/price".
+// A number is also the index of an array value, and '*' is every field of an object and
+// every value of an array: "/items/*/price". "" is the whole document. In the keys, "~1"
+// is '/' and "~0" is '~'.
+//
+class json_paths_t {
+public:
+	json_paths_t();
+	
+	// Returns the index of the path, which is passed to the callback (0, 1, 2, ...)
+	uint32_t add(const std::string& path);
+	
+	uint32_t size() const { return _paths; }
+	
+	static const uint32_t none = ~0u;
+	
+private:
+	friend struct extract_ctx_t;
+	friend bool extractJson(parser_t& p, const json_paths_t& paths, char * first, char * last,
+							path_callback_t callback, void * context);
+	
+	// the paths are a tree of keys
+	struct node_t {
+		std::string key;
+		uint32_t index;		// the key as an array index, or 'none'
+		uint32_t child;		// the first child, 0: none (the root is nobody's child)
+		uint32_t next;		// the next child of the parent, 0: none
+		uint32_t path;		// the path which ends here, or 'none'
+		bool wildcard;		// '*'
+	};
+	
+	std::vector<node_t> _nodes;	// _nodes[0] is the root
+	uint32_t _paths;
+	bool _wildcards;
+};
+
+
+//
+// On-demand extraction: the values at the paths are parsed and reported, the others are
+// skipped without callbacks or conversions. The objects and arrays are skipped by
+// matching the brackets and the quotes, their contents are not validated: a document
+// with an error in a skipped value may be accepted.
+//
+// When the paths have no '*', each path is reported once (the first match) and the
+// document isn't read after the last value found.
+//
+// The parser's callback is not used, the other preconditions and the errors are those of
+// parseJson. The buffer is modified: the strings reported are unescaped in place.
+//
+bool extractJson(parser_t& p, const json_paths_t& paths, char * first, char * last,
+				 path_callback_t callback, void * context);
+
+
+//
+// Push parser: the document is passed in chunks as it arrives (from a socket, a pipe, ...)
+// and the callbacks are invoked as with parseJson, with the same results and errors.
+// The chunks aren't modified and aren't needed after 'parse' returns.
+//
+// The memory used is the nesting stack plus the longest string which has escapes or
+// crosses a chunk boundary (these are copied), independent of the document size.
+// The positions (err_position, parsed_offset) are offsets from the start of the stream.
+//
+//    stream_parser_t sp;
+//    sp.set_callback(cb, ctx);
+//    while (auto n = read(fd, buf, sizeof(buf))) {
+//        if (!sp.parse(buf, buf+n)) ... sp.get_error()
+//    }
+//    if (!sp.finish()) ... sp.get_error()
+//
+class stream_parser_t : parser_base_t {
+
+public:
+	stream_parser_t();
+
+	void set_callback(parser_callback_t cb, void* ctx) {
+		callback = cb;
+		context = ctx;
+	}
+
+	void set_max_recursion(uint32_t maxr) {
+		max_recursion = maxr;
+	}
+	
+	uint32_t get_max_recursion() const {
+		return max_recursion;
+	}
+	
+	// Parses the next chunk of the document.
+	// Returns false if the document isn't valid, the maximum recursion depth was reached or the
+	// callback returned 'false'. The input following the top level value is ignored.
+	bool parse(const char * first, const char * last);
+	
+	// Signals the end of the document: a number or a literal at the end is completed.
+	// Returns true if a complete value was parsed.
+	bool finish();
+	
+	// Prepares the parser for another document, the callback and max_recursion are kept
+	void reset();
+	
+	// true after the top level value was parsed
+	bool done() const { return state == Done; }
+	
+	ParserErrors get_error() const { return error; }
+	
+	size_t get_err_position() const { return err_position; }
+	
+	// Gets the offset of the first character following the parsed value.
+	// The value is 0 until the value is complete or if the parser failed.
+	size_t get_parsed_offset() const { return parsed_offset; }
+
+private:
+	enum State : uint8_t {
+		Value,			// a value, after ':' or at the top level
+		Array_first,	// a value or ']'
+		Array_next,		// a value, after ','
+		Object_first,	// a key or '}'
+		Object_next,	// a key, after ','
+		Colon,
+		After_value,	// ',' or the end of the collection
+		String,			// inside a string, copied to 'token'
+		String_error,	// after a string with an invalid '\u' escape, see endString
+		Scalar,			// inside a number or a literal, copied to 'token'
+		Done,
+		Failed,
+	};
+	
+	bool parseChar(const char *& cur, const char * last);
+	bool beginValue(const char *& cur, const char * last);
+	bool beginString(const char *& cur, const char * last);
+	bool continueString(const char *& cur, const char * last);
+	bool endString(bool at_end);
+	bool stringError();
+	bool beginScalar(const char *& cur, const char * last);
+	bool continueScalar(const char *& cur, const char * last);
+	bool endScalar(bool at_end);
+	bool parseScalar(char * first, size_t len, bool at_end);
+	bool endCollection(const char *& cur);
+	bool endValue(size_t end_offset);
+	bool streamError(ParserErrors err, size_t offset);
+	
+	size_t chunkOffset(const char * ptr) const { return offset + (ptr - chunk); }
+	
+	std::string stack;		// '{' or '[' for each open collection
+	std::string token;		// the string or scalar being parsed, when it's copied
+	std::string saved;		// the string before parseString, see endString
+	const char * chunk;		// the chunk being parsed
+	size_t offset;			// stream offset of 'chunk'
+	size_t token_offset;	// stream offset of token[0]
+	size_t value_offset;	// stream offset of the value (Max_recursion error position)
+	size_t lookahead;		// chars which follow a String_error, still to be copied
+	State state;
+	bool key;				// the string is an object key
+	bool escape;			// the last char in 'token' is a '\' which starts an escape sequence
 };
 
 
@@ -1,16 +1,28 @@
 #include <algorithm>
-#include <float.h>
+#include <errno.h>
 #include <exception>
+#include <iterator>
 #include <stdio.h>
 #include <string.h>
-#include <charconv>
 #include "azp_json.h"
 #include "azp_json_api.h"
-
-
-#ifndef  DBL_DECIMAL_DIG
-#define DBL_DECIMAL_DIG 17
-#endif // ! DBL_DECIMAL_DIG
+#include "azp_json_pow10.h"
+#if defined(_M_X64) || defined(__x86_64__)
+	#define AZP_JSON_SIMD 1
+	#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+	#include <intrin.h>
+	#include <io.h>
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
 
 
 namespace azp {
@@ -40,11 +52,9 @@ struct less {
 			rsize = right.name.v.len;
 		}
 		
-		auto msize = std::min(lsize, rsize);
-		while (msize--) {
-			auto c = *lptr++ - *rptr++;
-			if (c) return c < 0;
-		}
+		// the bytes are unsigned: the UTF-8 names are in code point order
+		auto c = memcmp(lptr, rptr, std::min(lsize, rsize));
+		if (c) return c < 0;
 		
 		return lsize < rsize;
 	}
@@ -89,12 +99,14 @@ JsonValue& JsonValue::operator=(const JsonValue& other) {
 			;	// nothing to do
 		}
 
+		sorted = other.sorted;
 		return *this;
 	}
 	else {
 		switch (other.type) {
 			case Object: {
 				JsonValue tmp(other.u.object);
+				tmp.sorted = other.sorted;
 				return operator=(std::move(tmp));
 			}
 			case Array: {
@@ -159,6 +171,7 @@ JsonValue& JsonValue::operator=(JsonValue&& other) noexcept {
 	}
 	
 	type = other.type;
+	sorted = other.sorted;
 	
 	switch (other.type) {
 		case Object:
@@ -221,30 +234,25 @@ JsonValue::~JsonValue() noexcept {
 
 
 static size_t json_writer_size(const JsonValue& val);
-static void json_writer_imp(std::string& stm, const JsonValue& val);
+template <typename Out> static void json_writer_imp(Out& stm, const JsonValue& val);
 
 
+// The numbers are formatted without the C runtime (see double_to_string), the output
+// doesn't depend on the locale. The size is exact but for the escapes in the strings.
 void json_writer(std::string& stm, const JsonValue& val) {
-	auto old = setlocale(LC_NUMERIC, "C");
-	if (!old) throw std::exception(/*"runtime error"*/);
-	
 	auto size = json_writer_size(val);
-	size += size/3;
-	stm.reserve(size);
+	stm.reserve(stm.size() + size + size/16);
 	json_writer_imp(stm, val);
-	
-	if (!setlocale(LC_NUMERIC, old)) throw std::exception(/*"runtime error"*/);
 }
 
 
 template <typename Allocator>
 struct parser_callback_ctx_t {
-    vector<JsonValue, Allocator> stack;
+    vector<JsonValue, Allocator>& stack;
 	Allocator& a;
 	
-	// cppcheck-suppress noExplicitConstructor
-	parser_callback_ctx_t(Allocator& a) 
-		: stack(a), a(a)
+	parser_callback_ctx_t(vector<JsonValue, Allocator>& stack, Allocator& a) 
+		: stack(stack), a(a)
 	{ }
 };
 
@@ -254,42 +262,506 @@ static bool parser_callback(void* ctx, enum ParserTypes type, const value_t& val
 
 
 std::pair<JsonValue, std::string> json_reader(const std::string& stm) {
+	return json_reader(std::string(stm));
+}
+
+
+std::pair<JsonValue, std::string> json_reader(std::string&& stm) {
 	auto val = std::pair<JsonValue, std::string>();
+	
+	val.second = std::move(stm);
+	val.first = json_reader(&val.second[0], &val.second[0] + val.second.size());
+	
+	return val;
+}
 
-    if (!stm.empty()) {
-		parser_t p;
-		alloc_t a;
 
-		auto ctx = parser_callback_ctx_t<alloc_t>(a);
+JsonValue json_reader(char * first, char * last) {
+	JsonValue val;
+
+	if (first != last) {
+		parser_t p;
+		json_builder_t builder;
 
 		p.set_max_recursion(20);
-		p.set_callback(&parser_callback<alloc_t>, &ctx);
+		
+		if (!builder.build_exact(p, first, last, val)) {
+			throw std::exception(/*"cannot parse"*/);
+		}
+	}
+	
+	return val;
+}
 
-		ctx.stack.reserve(p.get_max_recursion() + 1);
-		val.second = stm;
-        
-        // ensure that we have something on the stack. This helps us avoid the empty stack case
-        parser_callback<alloc_t>(&ctx, Array_begin, value_t());
+
+std::pair<JsonValue, std::string> json_reader(const char * first, const char * last) {
+	auto val = std::pair<JsonValue, std::string>();
+
+	if (first != last) {
+		stream_parser_t p;
+		json_builder_t builder;
+
+		p.set_max_recursion(20);
 		
-		if (!parseJson(p, &val.second[0], &val.second[0]+val.second.size())) {
+		if (!builder.build_exact(p, first, last, val.first, val.second)) {
 			throw std::exception(/*"cannot parse"*/);
 		}
-        
-        val.first = std::move(*(ctx.stack.begin()->u.array.begin()));
 	}
 	
 	return val;
 }
 
 
-static void jsonEscape(const char* src, size_t len, std::string& dst);
-static void json_writer_object(std::string& stm, const JsonObject& val);
-static void json_writer_array(std::string& stm, const JsonArray& val);
-static void double_to_string(double dbl, std::string& stm);
-static void longlong_to_string(long long num, std::string& stm);
+// the allocator of the trees on the heap, they can outlive the builder
+static alloc_t g_heap_alloc;
+
+
+bool json_builder_t::build(parser_t& p, char * first, char * last, JsonValue& out) {
+	return build(p, first, last, out, g_heap_alloc);
+}
+
+
+bool json_builder_t::build(parser_t& p, char * first, char * last, JsonValue& out, alloc_t& a) {
+	auto ctx = parser_callback_ctx_t<alloc_t>(_stack, a);
+	p.set_callback(&parser_callback<alloc_t>, &ctx);
+	
+	_stack.reserve(p.get_max_recursion() + 1);
+	
+	// ensure that we have something on the stack. This helps us avoid the empty stack case
+	parser_callback<alloc_t>(&ctx, Array_begin, value_t());
+	
+	bool result = parseJson(p, first, last);
+	if (result) out = std::move(*(_stack.begin()->u.array.begin()));
+	
+	_stack.resize(0);	// the values are allocated with 'a', which may not outlive this call
+	return result;
+}
+
+
+bool json_builder_t::build_exact(parser_t& p, char * first, char * last, JsonValue& out) {
+	return build_exact(p, first, last, out, g_heap_alloc);
+}
+
+
+struct tape_ctx_t {
+	vector<json_tape_entry_t, alloc_t>& tape;
+	vector<uint32_t, alloc_t>& open;
+};
+
+
+// the first pass of build_exact: records the values and counts the fields and values
+static bool tape_callback(void* ctx, enum ParserTypes type, const value_t& value) noexcept {
+	auto& t = *(tape_ctx_t *)ctx;
+	
+	if (type == Object_end || type == Array_end) {
+		t.tape[t.open.back()].val.integer = int64_t(t.tape.size());
+		t.open.pop_back();
+		return true;
+	}
+	
+	// the fields of the objects are counted by their keys
+	if (t.open.size()) {
+		auto& parent = t.tape[t.open.back()];
+		if ((parent.type == Array_begin) | (type == Object_key)) parent.count++;
+	}
+	
+	if (type == Object_begin || type == Array_begin) t.open.push_back(uint32_t(t.tape.size()));
+	
+	t.tape.push_back(json_tape_entry_t{ type, 0, value });
+	return true;
+}
+
+
+//
+// The second pass of build_exact: constructs the value of the tape entry 'i' in 'v', which
+// is Empty; returns the index of the entry after the value.
+// The children are added to their vector before they're filled: an allocation failure
+// leaves a valid tree.
+//
+static size_t fill_value(const json_tape_entry_t * tape, size_t i, JsonValue& v, alloc_t& a) {
+	auto& e = tape[i++];
+	
+	switch (e.type) {
+		case Array_begin: {
+			new (&v.u.array) JsonArray(a, e.count);
+			v.type = JsonValue::Array;
+			
+			auto& arr = v.u.array;
+			for (uint32_t n = e.count; n; --n) {
+				new (arr._end) JsonValue();
+				arr._end++;
+				i = fill_value(tape, i, arr._end[-1], a);
+			}
+			break;
+		}
+		
+		case Object_begin: {
+			new (&v.u.object) JsonObject(a, e.count);
+			v.type = JsonValue::Object;
+			
+			auto& obj = v.u.object;
+			for (uint32_t n = e.count; n; --n) {
+				auto& key = tape[i++].val.string;
+				new (obj._end) JsonObjectField(string_view_t{key.p, key.len}, JsonValue());
+				obj._end++;
+				i = fill_value(tape, i, obj._end[-1].value, a);
+			}
+			break;
+		}
+		
+		case String_val:
+			new (&v) JsonValue(string_view_t{e.val.string.p, e.val.string.len});
+			break;
+			
+		case Number_int:
+			new (&v) JsonValue(e.val.integer);
+			break;
+			
+		case Number_float:
+			new (&v) JsonValue(e.val.number);
+			break;
+			
+		case Bool_true:
+			v.type = JsonValue::Bool_true;
+			break;
+			
+		case Bool_false:
+			v.type = JsonValue::Bool_false;
+			break;
+			
+		default: // case Null_val:
+			;	// Empty
+	}
+	
+	return i;
+}
+
+
+bool json_builder_t::build_exact(parser_t& p, char * first, char * last, JsonValue& out, alloc_t& a) {
+	_tape.set_size(0);
+	_open.set_size(0);
+	
+	tape_ctx_t ctx{ _tape, _open };
+	p.set_callback(&tape_callback, &ctx);
+	
+	if (!parseJson(p, first, last)) return false;
+	
+	JsonValue root;
+	fill_value(_tape.begin(), 0, root, a);
+	out = std::move(root);
+	return true;
+}
+
+
+bool json_builder_t::build_exact(stream_parser_t& p, const char * first, const char * last, JsonValue& out, std::string& unescaped) {
+	return build_exact(p, first, last, out, unescaped, g_heap_alloc);
+}
+
+
+struct tape_copy_ctx_t {
+	tape_ctx_t tape;
+	uintptr_t first, last;		// the buffer
+	std::string& unescaped;
+};
+
+
+//
+// The first pass of build_exact with the stream parser: the strings which are not in the
+// buffer were unescaped by the parser, they're appended to 'unescaped' and recorded with
+// their offset, the string may still grow.
+//
+static bool tape_copy_callback(void* ctx, enum ParserTypes type, const value_t& value) noexcept {
+	auto& t = *(tape_copy_ctx_t *)ctx;
+	
+	auto p = uintptr_t(value.string.p);
+	if ((type != Object_key && type != String_val) || (p >= t.first && p <= t.last)) {
+		return tape_callback(&t.tape, type, value);
+	}
+	
+	value_t offset;
+	offset.string.p = (const char *)t.unescaped.size();
+	offset.string.len = value.string.len;
+	
+	try {
+		// on the heap: a short string would be moved by copying it and the views wouldn't follow
+		if (t.unescaped.empty()) t.unescaped.reserve(64);
+		t.unescaped.append(value.string.p, value.string.len);
+	}
+	catch (std::exception&) {
+		return false;	// out of memory
+	}
+	
+	tape_callback(&t.tape, type, offset);
+	t.tape.tape.back().count = 1;
+	return true;
+}
+
+
+bool json_builder_t::build_exact(stream_parser_t& p, const char * first, const char * last, JsonValue& out, std::string& unescaped, alloc_t& a) {
+	_tape.set_size(0);
+	_open.set_size(0);
+	
+	tape_copy_ctx_t ctx{ { _tape, _open }, uintptr_t(first), uintptr_t(last), unescaped };
+	p.set_callback(&tape_copy_callback, &ctx);
+	
+	if (!p.parse(first, last) || !p.finish()) return false;
+	
+	// the offsets become pointers, 'unescaped' doesn't grow anymore
+	for (auto& e : _tape) {
+		if (e.count && (e.type == Object_key || e.type == String_val)) {
+			e.val.string.p = unescaped.data() + size_t(e.val.string.p);
+		}
+	}
+	
+	JsonValue root;
+	fill_value(_tape.begin(), 0, root, a);
+	out = std::move(root);
+	return true;
+}
+
+
+JsonDocument::JsonDocument() : _data(new data_t) { }
+
+
+JsonDocument::~JsonDocument() {
+	clear();
+}
+
+
+JsonDocument::JsonDocument(JsonDocument&& other) noexcept
+	: _data(std::move(other._data))
+	, _root(std::move(other._root))
+{ }
+
+
+JsonDocument& JsonDocument::operator=(JsonDocument&& other) noexcept {
+	if (this == &other) return *this;
+	
+	clear();
+	_data = std::move(other._data);
+	new (&_root) JsonValue(std::move(other._root));	// _root was dropped by clear()
+	return *this;
+}
+
+
+void JsonDocument::clear() noexcept {
+	// the root is dropped without running the destructors of the tree, its memory is in the arena
+	new (&_root) JsonValue();
+	
+	if (_data) {
+		_data->arena.reset();
+		_data->text.clear();
+		_data->file.close();
+	}
+}
+
+
+void JsonDocument::_parse(char * first, char * last) {
+	parser_t p;
+	json_builder_t builder;
+	p.set_max_recursion(20);
+	
+	if (!builder.build_exact(p, first, last, _root, allocator())) {
+		clear();
+		throw std::exception(/*"cannot parse"*/);
+	}
+}
+
+
+void json_reader(const std::string& stm, JsonDocument& doc) {
+	doc.clear();
+	
+	// the text of the previous document is reused
+	std::string text;
+	if (doc._data) text.swap(doc._data->text);
+	text = stm;
+	
+	json_reader(std::move(text), doc);
+}
+
+
+void json_reader(std::string&& stm, JsonDocument& doc) {
+	doc.clear();
+	if (stm.empty()) return;
+	
+	if (!doc._data) doc._data.reset(new JsonDocument::data_t);	// moved from
+	auto& text = doc._data->text;
+	text = std::move(stm);
+	
+	doc._parse(&text[0], &text[0] + text.size());
+}
+
+
+mapped_file_t::mapped_file_t() noexcept : _data(nullptr), _size(0), _writable(false) { }
+
+
+mapped_file_t::~mapped_file_t() {
+	close();
+}
+
+
+#if defined(_MSC_VER)
+bool mapped_file_t::open(const wchar_t * path, bool copy_on_write) noexcept {
+	close();
 
+	auto file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (GetFileType(file) != FILE_TYPE_DISK || !GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return false;
+	}
+
+	// an empty file cannot be mapped
+	if (size.QuadPart) {
+		auto mapping = CreateFileMappingW(file, nullptr, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+		auto view = mapping ? MapViewOfFile(mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+		// the view keeps the mapping and the file open
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+
+		if (!view) return false;
+		_data = (char *)view;
+	}
+	else {
+		CloseHandle(file);
+	}
+
+	_size = size_t(size.QuadPart);
+	_writable = copy_on_write;
+	return true;
+}
+
+
+void mapped_file_t::close() noexcept {
+	if (_data) UnmapViewOfFile(_data);
+	_data = nullptr;
+	_size = 0;
+	_writable = false;
+}
 
-static void json_writer_imp(std::string& stm, const JsonValue& val) {
+#else
+
+bool mapped_file_t::open(const char * path, bool copy_on_write) noexcept {
+	close();
+
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		::close(fd);
+		return false;
+	}
+
+	// an empty file cannot be mapped
+	size_t size = size_t(st.st_size);
+	if (size) {
+		auto view = mmap(nullptr, size, copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED) {
+			::close(fd);
+			return false;
+		}
+
+		// the whole file is read, start reading ahead
+		madvise(view, size, MADV_WILLNEED);
+		_data = (char *)view;
+	}
+
+	::close(fd);	// the mapping keeps the file open
+	_size = size;
+	_writable = copy_on_write;
+	return true;
+}
+
+
+void mapped_file_t::close() noexcept {
+	if (_data) munmap(_data, _size);
+	_data = nullptr;
+	_size = 0;
+	_writable = false;
+}
+
+#endif // _MSC_VER
+
+
+// reads what's left of 'f' (a pipe: the size isn't known)
+static bool read_file(FILE * f, std::string& text) {
+	size_t size = 0;
+	
+	for (;;) {
+		if (size == text.size()) text.resize(std::max<size_t>(text.size() * 2, 65536));
+		
+		auto n = fread(&text[size], 1, text.size() - size, f);
+		if (!n) break;
+		size += n;
+	}
+	
+	text.resize(size);
+	return !ferror(f);
+}
+
+
+#if defined(_MSC_VER)
+void json_read_file(const wchar_t * path, JsonDocument& doc) {
+#else
+void json_read_file(const char * path, JsonDocument& doc) {
+#endif
+	doc.clear();
+	
+	if (!doc._data) doc._data.reset(new JsonDocument::data_t);	// moved from
+	auto& file = doc._data->file;
+	
+	if (file.open(path, true)) {
+		if (file.size()) doc._parse(file.writable_data(), file.writable_data() + file.size());
+		return;
+	}
+	
+	// not a regular file, or it cannot be mapped
+#if defined(_MSC_VER)
+	auto f = _wfopen(path, L"rb");
+#else
+	auto f = fopen(path, "rb");
+#endif
+	if (!f) throw std::exception(/*"cannot open file"*/);
+	
+	std::string text;
+	text.swap(doc._data->text);	// reused
+	
+	bool ok = read_file(f, text);
+	fclose(f);
+	if (!ok) throw std::exception(/*"cannot read file"*/);
+	
+	json_reader(std::move(text), doc);
+}
+
+
+#if defined(_MSC_VER)
+JsonDocument json_read_file(const wchar_t * path) {
+#else
+JsonDocument json_read_file(const char * path) {
+#endif
+	JsonDocument doc;
+	json_read_file(path, doc);
+	return doc;
+}
+
+
+//
+// The writer functions append to a std::string (json_writer) or to a json_output_t
+// (the streaming writers), which have the same push_back and append.
+//
+template <typename Out> static void jsonEscape(const char* src, size_t len, Out& dst);
+template <typename Out> static void json_writer_object(Out& stm, const JsonObject& val);
+template <typename Out> static void json_writer_array(Out& stm, const JsonArray& val);
+template <typename Out> static void double_to_string(double dbl, Out& stm);
+template <typename Out> static void longlong_to_string(long long num, Out& stm);
+
+
+template <typename Out>
+static void json_writer_imp(Out& stm, const JsonValue& val) {
 	switch (val.type) {
 		case JsonValue::Object:
 			json_writer_object(stm, val.u.object);
@@ -333,84 +805,321 @@ static void json_writer_imp(std::string& stm, const JsonValue& val) {
 	}
 }
 
-/*
-This code gives us perfect precision at performance cost
-static const struct num_size_t {
-	uint32_t val;
-	size_t size;
-} g_tabl[] = {
-	{ 10, 1 },
-	{ 100, 2 },
-	{ 1000, 3 },
-	{ 10000, 4 },
-	{ 100000, 5 },
-	{ 1000000, 6 },
-	{ 10000000, 7 },
-	{ 100000000, 8 },
-	{ 1000000000, 9 },
+//
+// Number formatting
+//
+// The doubles are written with the fewest digits which read back to the same double (the
+// shortest round trip, as std::to_chars without a precision), computed with the Schubfach
+// algorithm (R. Giulietti, "The Schubfach way to render doubles", 2020): the bounds of the
+// interval of the decimals which round to the double are multiplied by a 128-bit power of
+// 10, then the shortest decimal in the interval is taken, the closest one if there are
+// several. The notation is the one of "%g": fixed for the exponents from -4 to 16,
+// scientific otherwise. There's no locale and no C runtime call.
+// The sizes are computed the same way, so json_writer_size is exact for the numbers.
+//
+
+struct product128_t {
+	uint64_t low;
+	uint64_t high;
 };
 
 
-static size_t number_size(int32_t num) {
-	uint32_t n;
-	int32_t negative = 0;
+static inline product128_t multiply128(uint64_t a, uint64_t b) {
+	product128_t r;
+#if defined(_MSC_VER) && defined(_M_X64)
+	r.low = _umul128(a, b, &r.high);
+#elif defined(__SIZEOF_INT128__)
+	unsigned __int128 x = (unsigned __int128)a * b;
+	r.low = uint64_t(x);
+	r.high = uint64_t(x >> 64);
+#else
+	uint64_t a_lo = uint32_t(a), a_hi = a >> 32;
+	uint64_t b_lo = uint32_t(b), b_hi = b >> 32;
+	uint64_t lo_lo = a_lo * b_lo, hi_lo = a_hi * b_lo;
+	uint64_t lo_hi = a_lo * b_hi, hi_hi = a_hi * b_hi;
+	uint64_t cross = (lo_lo >> 32) + uint32_t(hi_lo) + lo_hi;
+	r.low = (cross << 32) | uint32_t(lo_lo);
+	r.high = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+#endif
+	return r;
+}
+
+
+// assumes x != 0
+static inline uint32_t countLeadingZeros64(uint64_t x) {
+#if defined(_MSC_VER)
+	unsigned long pos;
+	if (_BitScanReverse(&pos, uint32_t(x >> 32))) return 31 - pos;
+	_BitScanReverse(&pos, uint32_t(x));
+	return 63 - pos;
+#else
+	return __builtin_clzll(x);
+#endif
+}
+
+
+static const uint64_t g_pow10[20] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+	1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+	1000000000000000000ULL, 10000000000000000000ULL,
+};
+
+
+static size_t count_digits(uint64_t n) {
+	if (n < 10) return 1;
+	
+	// floor(log10(n)) is floor(log2(n)) * log10(2) or 1 more
+	uint32_t t = ((64 - countLeadingZeros64(n)) * 1233) >> 12;
+	return t + (n >= g_pow10[t]);
+}
+
+
+static const char g_digit_pairs[] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+
+// writes the digits of 'n' before 'last', returns the first digit
+static char * write_digits(char * last, uint64_t n) {
+	while (n >= 100) {
+		auto d = n % 100;
+		n /= 100;
+		last -= 2;
+		memcpy(last, g_digit_pairs + 2*d, 2);
+	}
 	
-	if (num >= 0) n = num;
+	if (n >= 10) {
+		last -= 2;
+		memcpy(last, g_digit_pairs + 2*n, 2);
+	}
 	else {
-		if ((uint32_t)num == 0x80000000U) return 11;
-		n = -num;
-		negative = 1;	// minus sign
-	}
-	
-	auto tabend = g_tabl + sizeof(g_tabl) / sizeof(g_tabl[0]);
-	auto pos = std::lower_bound(g_tabl, tabend, n, [](const num_size_t& el, uint32_t num)
-	{
-		return num >= el.val;
-	});
-	
-	return negative + ((pos != tabend) ? pos->size : 10);
-}
-
-
-static const struct num_size_ll_t {
-	uint64_t val;
-	size_t size;
-} g_tabll[] = {
-	{ 10000000000LL, 10 },
-	{ 100000000000LL, 11 },
-	{ 1000000000000LL, 12 },
-	{ 10000000000000LL, 13 },
-	{ 100000000000000LL, 14 },
-	{ 1000000000000000LL, 15 },
-	{ 10000000000000000LL, 16 },
-	{ 100000000000000000LL, 17 },
-	{ 1000000000000000000LL, 18 },		// LLONG_MAX  9,223,372,036,854,775,807LL
+		*--last = char('0' + n);
+	}
+	
+	return last;
+}
+
+
+static size_t longlong_size(long long num) {
+	return (num < 0) + count_digits((num < 0) ? 0 - uint64_t(num) : uint64_t(num));
+}
+
+
+template <typename Out>
+static void longlong_to_string(long long num, Out& stm) {
+	char buf[24];
+	auto last = std::end(buf);
+	auto first = write_digits(last, (num < 0) ? 0 - uint64_t(num) : uint64_t(num));
+	if (num < 0) *--first = '-';
+	stm.append(first, last);
+}
+
+
+// the value is digits * 10^exponent
+struct decimal_t {
+	uint64_t digits;
+	int32_t exponent;
 };
 
 
-static size_t number_size(int64_t num) {
-	int32_t negative = 0;
-	
-	uint64_t n;
+// 'g' times 'cp' divided by 2^128, rounded to odd (the low bit is set if it's not exact)
+static inline uint64_t round_to_odd(const uint64_t * g, uint64_t cp) {
+	auto low = multiply128(g[1], cp);
+	auto high = multiply128(g[0], cp);
 	
-	if (num >= -2147483647 && num <= 2147483647) return number_size(int32_t(num));
+	uint64_t mid = high.low + low.high;
+	uint64_t result = high.high + (mid < high.low);
+	return result | (mid > 1);
+}
+
+
+//
+// The shortest decimal of a double which is not 0, infinity or NaN (the sign apart),
+// from the bits of the significand and of the exponent
+//
+static decimal_t to_decimal(uint64_t significand, int32_t exponent) {
+	constexpr int32_t mantissa_bits = 52;
+	constexpr int32_t exponent_bias = 1023 + mantissa_bits;
 	
-	if (num >= 0) n = num;
+	uint64_t c;
+	int32_t q;	// the double is c * 2^q
+	if (exponent) {
+		c = (uint64_t(1) << mantissa_bits) | significand;
+		q = exponent - exponent_bias;
+		
+		// the integers below 2^53 are exact
+		if (q <= 0 && -q <= mantissa_bits && (c & ((uint64_t(1) << -q) - 1)) == 0) {
+			return decimal_t{ c >> -q, 0 };
+		}
+	}
 	else {
-		if ((uint64_t)num == 0x8000000000000000ULL) return 20;
-		n = -num;
-		negative = 1;
+		c = significand;
+		q = 1 - exponent_bias;
+	}
+	
+	// the bounds of the interval, times 4; the lower one is closer at a power of 2
+	bool is_even = (c % 2 == 0);
+	bool lower_closer = (significand == 0 && exponent > 1);
+	
+	uint64_t cbl = 4 * c - 2 + lower_closer;
+	uint64_t cb = 4 * c;
+	uint64_t cbr = 4 * c + 2;
+	
+	// k = floor(log10(2^q)), or floor(log10(3/4 * 2^q)) if the lower bound is closer
+	int32_t k = (q * 1262611 - (lower_closer ? 524031 : 0)) >> 22;
+	int32_t h = q + ((-k * 1741647) >> 19) + 1;		// + floor(log2(10^-k)), h is 1 to 4
+	
+	auto g = pow10_128 + 2 * (-k - pow10_min_exponent);
+	uint64_t vbl = round_to_odd(g, cbl << h);
+	uint64_t vb = round_to_odd(g, cb << h);
+	uint64_t vbr = round_to_odd(g, cbr << h);
+	
+	uint64_t lower = vbl + !is_even;
+	uint64_t upper = vbr - !is_even;
+	
+	decimal_t dec;
+	uint64_t s = vb / 4;
+	
+	// one digit less if a multiple of 10 is in the interval
+	bool done = false;
+	if (s >= 10) {
+		uint64_t sp = s / 10;
+		bool up_inside = lower <= 40 * sp;
+		bool wp_inside = 40 * sp + 40 <= upper;
+		if (up_inside != wp_inside) {
+			dec = decimal_t{ sp + wp_inside, k + 1 };
+			done = true;
+		}
+	}
+	
+	if (!done) {
+		bool u_inside = lower <= 4 * s;
+		bool w_inside = 4 * s + 4 <= upper;
+		if (u_inside != w_inside) {
+			dec = decimal_t{ s + w_inside, k };
+		}
+		else {
+			// both are in the interval, the closest one (to even if it's in the middle)
+			uint64_t mid = 4 * s + 2;
+			bool round_up = vb > mid || (vb == mid && (s & 1) != 0);
+			dec = decimal_t{ s + round_up, k };
+		}
 	}
 	
-	auto tabend = g_tabll + sizeof(g_tabll) / sizeof(g_tabll[0]);
-	auto pos = std::lower_bound(g_tabll, tabend, n, [](const num_size_ll_t& el, uint64_t num)
-	{
-		return num >= el.val;
-	});
+	while (dec.digits % 10 == 0) {
+		dec.digits /= 10;
+		dec.exponent++;
+	}
+	
+	return dec;
+}
+
+
+//
+// Returns false for infinity and NaN; 'dec' is 0 for 0
+//
+static bool split_double(double dbl, bool& negative, decimal_t& dec) {
+	uint64_t bits;
+	memcpy(&bits, &dbl, sizeof(bits));
+	
+	negative = (bits >> 63) != 0;
+	auto significand = bits & ((uint64_t(1) << 52) - 1);
+	auto exponent = int32_t((bits >> 52) & 0x7FF);
 	
-	return negative + ((pos != tabend) ? pos->size : 19);
+	if (exponent == 0x7FF) return false;
+	
+	if (exponent == 0 && significand == 0) dec = decimal_t{ 0, 0 };
+	else dec = to_decimal(significand, exponent);
+	return true;
 }
-//*/
+
+
+// the exponent of the first digit; the scientific notation is used for x < -4 || x > 16
+static inline int32_t decimal_point(const decimal_t& dec, size_t n) {
+	return int32_t(n) + dec.exponent - 1;
+}
+
+
+static size_t double_size(double dbl) {
+	bool negative;
+	decimal_t dec;
+	if (!split_double(dbl, negative, dec)) return 4;	// null
+	
+	auto n = count_digits(dec.digits);
+	auto x = decimal_point(dec, n);
+	size_t size = negative;
+	
+	if (x < -4 || x > 16) {
+		auto ax = (x < 0) ? -x : x;
+		size += n + (n > 1) + 2 + ((ax >= 100) ? 3 : (ax >= 10) ? 2 : 1);	// d.ddde-xxx
+	}
+	else if (dec.exponent >= 0) size += n + dec.exponent;		// ddd000
+	else if (x >= 0) size += n + 1;								// dd.ddd
+	else size += n + 1 - x;										// 0.000ddd
+	
+	return size;
+}
+
+
+//
+// JSON has no infinity and NaN, they're written as null
+//
+template <typename Out>
+static void double_to_string(double dbl, Out& stm) {
+	bool negative;
+	decimal_t dec;
+	if (!split_double(dbl, negative, dec)) {
+		stm.append("null");
+		return;
+	}
+	
+	char buf[32];
+	char * p = buf;
+	if (negative) *p++ = '-';
+	
+	auto n = count_digits(dec.digits);
+	auto x = decimal_point(dec, n);
+	
+	if (x < -4 || x > 16) {
+		// d.ddde-xxx: the digits are written after the first one, which is moved before the '.'
+		write_digits(p + 1 + n, dec.digits);
+		p[0] = p[1];
+		p[1] = '.';
+		p += n + (n > 1);
+		
+		*p++ = 'e';
+		*p++ = (x < 0) ? '-' : '+';
+		auto ax = uint64_t((x < 0) ? -x : x);
+		p += count_digits(ax);
+		write_digits(p, ax);
+	}
+	else if (dec.exponent >= 0) {
+		p += n;
+		write_digits(p, dec.digits);
+		memset(p, '0', dec.exponent);
+		p += dec.exponent;
+	}
+	else if (x >= 0) {
+		// the integer part is moved before the '.'
+		write_digits(p + 1 + n, dec.digits);
+		memmove(p, p + 1, x + 1);
+		p[x + 1] = '.';
+		p += n + 1;
+	}
+	else {
+		p[0] = '0';
+		p[1] = '.';
+		memset(p + 2, '0', -x - 1);
+		p += 1 - x + n;
+		write_digits(p, dec.digits);
+	}
+	
+	stm.append(buf, p);
+}
+
+
 
 static size_t json_writer_object_size(const JsonObject& val) {
 	size_t size = 2;
@@ -465,13 +1174,11 @@ static size_t json_writer_size(const JsonValue& val) {
 			break;
 			
 		case JsonValue::Number:
-			//size = number_size(val.u.number);
-            size = 8;
+			size = longlong_size(val.u.number);
 			break;
 			
 		case JsonValue::Float_num:
-			//size = double_to_string_size(val.u.float_num);	// more expensive than potentially doing an allocation
-			size = 15;	// any number that cannot be exactly represented will require at least 19 chars
+			size = double_size(val.u.float_num);
 			break;
 			
 		case JsonValue::Bool_false:
@@ -510,7 +1217,8 @@ static const char * const esctab[0x20] = {
     };
 
 
-static void escape(std::string& dst, char ch)
+template <typename Out>
+static void escape(Out& dst, char ch)
 {
 	if (ch == '"' || ch == '\\') {
 		dst.push_back('\\');
@@ -522,30 +1230,63 @@ static void escape(std::string& dst, char ch)
 }
 
 
-static void jsonEscape(const char* src, size_t len, std::string& dst)
+// assumes mask != 0
+static inline uint32_t countTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+	unsigned long pos;
+	_BitScanForward(&pos, mask);
+	return pos;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+
+// returns the first char of [first, last) to escape, or 'last'. The safe runs are tested
+// 16 chars at a time (SSE2, always there on x86-64); the scan of the parser would select
+// AVX2 at runtime but the call and the dispatch cost more than they save with the short
+// strings of most documents.
+static inline const char * findEscape(const char * first, const char * last)
+{
+#if defined(AZP_JSON_SIMD)
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i bslash = _mm_set1_epi8('\\');
+	const __m128i ctrl = _mm_set1_epi8(0x1F);
+
+	for (; last - first >= 16; first += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)first);
+		__m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_min_epu8(v, ctrl), v));	// v <= 0x1F
+
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(m);
+		if (mask) return first + countTrailingZeros(mask);
+	}
+#endif
+	for (; first != last; ++first) {
+		if (needEscape(*first)) return first;
+	}
+	return first;
+}
+
+
+template <typename Out>
+static void jsonEscape(const char* src, size_t len, Out& dst)
 {
     auto last = src + len;
-    
-    while (src != last) {
-        auto stop = src;
-
-        while (!needEscape(*stop)) {
-            stop++;
-            if (stop == last) {
-				dst.append(src, stop);
-				return;
-			}
-        }
 
+    for (;;) {
+        auto stop = findEscape(src, last);
         dst.append(src, stop);
-		escape(dst, *stop);
+        if (stop == last) return;
 
+		escape(dst, *stop);
         src = stop+1;
     }
 }
 
 
-static void json_writer_object(std::string& stm, const JsonObject& val) {
+template <typename Out>
+static void json_writer_object(Out& stm, const JsonObject& val) {
 	stm.push_back('{');
 	
 	if (val.cbegin() != val.cend()) {
@@ -569,7 +1310,8 @@ static void json_writer_object(std::string& stm, const JsonObject& val) {
 }
 
 
-static void json_writer_array(std::string& stm, const JsonArray& val) {
+template <typename Out>
+static void json_writer_array(Out& stm, const JsonArray& val) {
 	stm.push_back('[');
 	if (val.cbegin() != val.cend()) {
 		auto it = val.cbegin();
@@ -583,6 +1325,138 @@ static void json_writer_array(std::string& stm, const JsonArray& val) {
 }
 
 
+bool json_file_sink(void * file, const char * data, size_t size) {
+	return fwrite(data, 1, size, (FILE *)file) == size;
+}
+
+
+bool json_fd_sink(void * fd, const char * data, size_t size) {
+	while (size) {
+#if defined(_MSC_VER)
+		auto n = _write(int(intptr_t(fd)), data, unsigned(std::min<size_t>(size, 1 << 30)));
+#else
+		auto n = ::write(int(intptr_t(fd)), data, size);
+		if (n < 0 && errno == EINTR) continue;
+#endif
+		if (n <= 0) return false;
+		data += n;
+		size -= size_t(n);
+	}
+	return true;
+}
+
+
+json_output_t::json_output_t(json_sink_t sink, void * context, size_t buffer_size)
+	: _sink(sink)
+	, _context(context)
+	, _buf(new char[std::max<size_t>(buffer_size, 64)])
+	, _flushed(0)
+	, _failed(false)
+{
+	_pos = _buf.get();
+	_end = _pos + std::max<size_t>(buffer_size, 64);
+}
+
+
+json_output_t::~json_output_t() {
+	flush();
+}
+
+
+bool json_output_t::flush() {
+	auto size = size_t(_pos - _buf.get());
+	_pos = _buf.get();
+	
+	// after a failure the text is dropped
+	if (size && !_failed) {
+		_failed = !_sink(_context, _buf.get(), size);
+		_flushed += size;
+	}
+	
+	return !_failed;
+}
+
+
+void json_output_t::_flush_full() {
+	flush();
+}
+
+
+void json_output_t::_append_long(const char * data, size_t size) {
+	// the buffer is filled and flushed, the rest goes to the buffer if it fits
+	auto n = size_t(_end - _pos);
+	memcpy(_pos, data, n);
+	_pos += n;
+	flush();
+	
+	data += n;
+	size -= n;
+	
+	if (size < size_t(_end - _pos)) {
+		memcpy(_pos, data, size);
+		_pos += size;
+	}
+	else if (!_failed) {
+		_failed = !_sink(_context, data, size);
+		_flushed += size;
+	}
+}
+
+
+bool json_writer(json_output_t& out, const JsonValue& val) {
+	json_writer_imp(out, val);
+	return out.flush();
+}
+
+
+void json_sax_writer_t::key(const char * str, size_t len) {
+	_separator();
+	_out.push_back('"');
+	jsonEscape(str, len, _out);
+	_out.append("\":", 2);
+	_comma = false;		// the value follows
+}
+
+
+void json_sax_writer_t::value(const char * str, size_t len) {
+	_separator();
+	_out.push_back('"');
+	jsonEscape(str, len, _out);
+	_out.push_back('"');
+}
+
+
+void json_sax_writer_t::value(int64_t num) {
+	_separator();
+	longlong_to_string(num, _out);
+}
+
+
+void json_sax_writer_t::value(double num) {
+	_separator();
+	double_to_string(num, _out);
+}
+
+
+void json_sax_writer_t::value(bool val) {
+	_separator();
+	if (val) _out.append("true", 4);
+	else _out.append("false", 5);
+}
+
+
+void json_sax_writer_t::value(std::nullptr_t) {
+	_separator();
+	_out.append("null", 4);
+}
+
+
+void json_sax_writer_t::value(const JsonValue& val) {
+	_separator();
+	json_writer_imp(_out, val);
+}
+
+
 template <typename Allocator>
 static bool add_scalar_value(parser_callback_ctx_t<Allocator>& cbCtx, JsonValue&& data) {
     JsonValue& val = cbCtx.stack.back();
@@ -663,44 +1537,6 @@ static bool parser_callback(void* ctx, enum ParserTypes type, const value_t& val
 }
 
 
-#ifdef _MSC_VER
-static void double_to_string(double dbl, std::string& stm) {
-	size_t len;
-    char buf[1024] = { 0, };
-    len = sprintf(buf, "%.*g", DBL_DECIMAL_DIG, dbl);
-    stm.append(buf, buf+len);
-}
-#else
-static void double_to_string(double dbl, std::string& stm) {
-	std::to_chars_result;
-	char buf[1024] = {0,};
-	res = std::to_chars(buf, std::end(buf), dbl, std::chars_format::general, DBL_DECIMAL_DIG);
-	if (res.ec == std::errc()) {
-		stm.append(buf, res.ptr);
-	}
-	else {
-		throw std::exception();
-	}
-}
-#endif
-
-
-static void longlong_to_string(long long num, std::string& stm) {
-	auto first = &stm.back();
-	auto last = first + (stm.capacity() - stm.size());
-	auto res = std::to_chars(first, last, num, 10);
-	if (res.ec == std::errc()) {
-		stm._Get_data()._Mysize += res.ptr - first;
-	}
-	else {
-		char buf[64] = { 0, };
-		res = std::to_chars(buf, std::end(buf), num, 10);
-		if (res.ec != std::errc()) throw std::exception();
-		stm.append(buf, res.ptr);
-	}
-}
-
-
 JsonObjectField& JsonObjectField::operator=(JsonObjectField&& other) noexcept {
 	if (type == String) {
 		name.s.~JsonString();
@@ -740,6 +1576,7 @@ void optimize_for_search(JsonValue& root) noexcept {
 		auto& obj = root.u.object;
 		
 		std::sort(obj.begin(), obj.end(), less());
+		root.sorted = true;
 		
 		for (auto& v : obj) {
 			optimize_for_search(v.value);
@@ -753,4 +1590,143 @@ void optimize_for_search(JsonValue& root) noexcept {
 	else { }
 }
 
+
+// the order of 'less'
+static int compare_name(const JsonObjectField& f, const char * key, size_t len) noexcept {
+	auto size = f.nameSize();
+	auto c = memcmp(f.nameStr(), key, std::min(size, len));
+	if (c) return c;
+	
+	return (size < len) ? -1 : (size > len);
+}
+
+
+static const JsonObjectField * find_field(const JsonObject& obj, const char * key, size_t len) noexcept {
+	for (auto& f : obj) {
+		if (f.nameSize() == len && memcmp(f.nameStr(), key, len) == 0) return &f;
+	}
+	return nullptr;
+}
+
+
+static const JsonObjectField * find_sorted_field(const JsonObject& obj, const char * key, size_t len) noexcept {
+	auto first = obj.begin();
+	auto n = obj.size();
+	
+	// lower bound
+	while (n) {
+		auto half = n / 2;
+		if (compare_name(first[half], key, len) < 0) {
+			first += half + 1;
+			n -= half + 1;
+		}
+		else n = half;
+	}
+	
+	return (first != obj.end() && compare_name(*first, key, len) == 0) ? first : nullptr;
+}
+
+
+const JsonValue * JsonValue::find(const char * key, size_t len) const noexcept {
+	if (type != Object) return nullptr;
+	
+	// the small objects are faster to search linearly
+	bool binary = sorted && u.object.size() >= JsonObjectIndex::min_fields;
+	auto f = binary ? find_sorted_field(u.object, key, len) : find_field(u.object, key, len);
+	return f ? &f->value : nullptr;
+}
+
+
+JsonValue * JsonValue::find(const char * key, size_t len) noexcept {
+	return const_cast<JsonValue *>(static_cast<const JsonValue *>(this)->find(key, len));
+}
+
+
+// 8 chars at a time, multiply and fold
+static uint64_t hash_name(const char * s, size_t len) noexcept {
+	uint64_t h = len * 0x9E3779B97F4A7C15ull;
+	
+	for (; len >= 8; s += 8, len -= 8) {
+		uint64_t w;
+		memcpy(&w, s, 8);
+		h = (h ^ w) * 0xFF51AFD7ED558CCDull;
+		h ^= h >> 32;
+	}
+	
+	uint64_t w = 0;
+	memcpy(&w, s, len);
+	h = (h ^ w) * 0xC4CEB9FE1A85EC53ull;
+	return h ^ (h >> 29);
+}
+
+
+JsonObjectIndex::JsonObjectIndex(const JsonObject& obj) noexcept
+	: _obj(&obj)
+	, _start(nullptr)
+	, _count(0)
+{ }
+
+
+void JsonObjectIndex::build() {
+	size_t size = 16;
+	while (size < 2 * _obj->size()) size *= 2;
+	
+	_slots.assign(size, 0);
+	_start = _obj->begin();
+	_count = _obj->size();
+	
+	auto mask = size - 1;
+	for (size_t pos = 0; pos < _count; ++pos) {
+		auto& f = _start[pos];
+		auto h = hash_name(f.nameStr(), f.nameSize());
+		auto tag = h >> 32;
+		
+		// the first field with the name is kept
+		for (auto i = size_t(h) & mask; ; i = (i + 1) & mask) {
+			auto slot = _slots[i];
+			if (!slot) {
+				_slots[i] = (tag << 32) | (pos + 1);
+				break;
+			}
+			
+			auto& other = _start[uint32_t(slot) - 1];
+			if ((slot >> 32) == tag && other.nameSize() == f.nameSize() && memcmp(other.nameStr(), f.nameStr(), f.nameSize()) == 0) break;
+		}
+	}
+}
+
+
+const JsonValue * JsonObjectIndex::find(const char * key, size_t len) {
+	auto& obj = *_obj;
+	if (obj.size() < min_fields) {
+		auto f = find_field(obj, key, len);
+		return f ? &f->value : nullptr;
+	}
+	
+	if (obj.begin() != _start || obj.size() != _count) build();
+	
+	auto h = hash_name(key, len);
+	auto tag = h >> 32;
+	
+	for (bool retry = true; ; retry = false) {
+		auto mask = _slots.size() - 1;
+		bool stale = false;
+		
+		for (auto i = size_t(h) & mask; ; i = (i + 1) & mask) {
+			auto slot = _slots[i];
+			if (!slot) break;
+			
+			if ((slot >> 32) == tag) {
+				auto& f = _start[uint32_t(slot) - 1];
+				if (f.nameSize() == len && memcmp(f.nameStr(), key, len) == 0) return &f.value;
+				stale = true;
+			}
+		}
+		
+		// the fields were reordered in place (or, rarely, two names have the same tag)
+		if (!stale || !retry) return nullptr;
+		build();
+	}
+}
+
 } // namespace asu
@@ -1,16 +1,36 @@
 #pragma once
 
 #include <string>
+#include <memory>
+#include <vector>
 #include <assert.h>
+#include <string.h>
 #include "azp_vector.h"
+#include "azp_json.h"
 
 
 namespace azp {
 
 struct JsonObjectField;
 struct JsonValue;
+class json_arena_t;
 
-using alloc_t = default_alloc_t;
+
+//
+// The allocator of the objects and arrays: the heap, or the arena of a JsonDocument
+//
+struct json_alloc_t {
+	json_alloc_t() noexcept : arena(nullptr) { }
+	explicit json_alloc_t(json_arena_t * arena_) noexcept : arena(arena_) { }
+	
+	block_t alloc(size_t n);
+	void free(block_t b);
+	bool owns(block_t) const { return true; }
+	
+	json_arena_t * arena;	// nullptr: malloc and free
+};
+
+using alloc_t = json_alloc_t;
 
 typedef vector<JsonObjectField, alloc_t>  JsonObject;
 typedef vector<JsonValue, alloc_t>  JsonArray;
@@ -41,6 +61,10 @@ struct JsonValue {
 		Max_types
 	} type;
 	
+	// Object: the fields are sorted by name (optimize_for_search), find uses a binary search.
+	// Set it to false after adding or renaming fields.
+	bool sorted;
+	
 	union Impl {
 		JsonObject    object;
 		JsonArray     array;
@@ -73,6 +97,16 @@ struct JsonValue {
 	
     ~JsonValue() noexcept;
 	
+	//
+	// The value of a field named 'key' of an object (the first one, unless the fields are
+	// sorted), or nullptr if there's none or if the value isn't an object.
+	// A binary search if the object is sorted, a linear search otherwise.
+	// @see JsonObjectIndex for the large objects searched many times
+	//
+	JsonValue * find(const char * key, size_t len) noexcept;
+	const JsonValue * find(const char * key, size_t len) const noexcept;
+	const JsonValue * find(const std::string& key) const noexcept { return find(key.data(), key.size()); }
+	
 protected:
 	void _initString(JsonString&& str) noexcept;
 };
@@ -87,10 +121,130 @@ protected:
 //
 void json_writer(std::string& stm, const JsonValue& val);
 
+
+//
+// Receives the text of a streaming writer in pieces, returns false if it cannot be
+// written: the writing stops. @see json_output_t
+//
+typedef bool (* json_sink_t)(void * context, const char * data, size_t size);
+
+// The sinks of a FILE * (the context) and of a file descriptor ((void *)(intptr_t)fd)
+bool json_file_sink(void * file, const char * data, size_t size);
+bool json_fd_sink(void * fd, const char * data, size_t size);
+
+
+//
+// The output of the streaming writers: a buffer of a fixed size, passed to the sink
+// each time it's full. The text longer than the buffer is passed directly.
+// The memory used doesn't depend on the size of the document, and the first bytes are
+// sent before the end of the document is written.
+//
+//    json_output_t out(json_file_sink, stdout);
+//    json_writer(out, val);
+//    if (!out.flush()) ...
+//
+class json_output_t {
+public:
+	json_output_t(json_sink_t sink, void * context, size_t buffer_size = 64 * 1024);
+	~json_output_t();	// flushes, use flush() to know if it failed
+	
+	json_output_t(const json_output_t&) = delete;
+	json_output_t& operator=(const json_output_t&) = delete;
+	
+	void push_back(char c) {
+		if (_pos == _end) _flush_full();
+		*_pos++ = c;
+	}
+	
+	void append(const char * data, size_t size) {
+		if (size_t(_end - _pos) >= size) {
+			memcpy(_pos, data, size);
+			_pos += size;
+		}
+		else _append_long(data, size);
+	}
+	
+	void append(const char * first, const char * last) { append(first, size_t(last - first)); }
+	void append(const char * str) { append(str, strlen(str)); }
+	
+	// Passes the text buffered to the sink. Returns false if the sink failed, now or before
+	bool flush();
+	
+	bool failed() const { return _failed; }
+	
+	// Bytes written, including those still in the buffer
+	size_t size() const { return _flushed + size_t(_pos - _buf.get()); }
+	
+private:
+	void _flush_full();
+	void _append_long(const char * data, size_t size);
+	
+	json_sink_t _sink;
+	void * _context;
+	std::unique_ptr<char[]> _buf;
+	char * _pos;
+	char * _end;
+	size_t _flushed;
+	bool _failed;
+};
+
+//
+// Serializes the JsonValue to 'out', the same text as json_writer above; the text is
+// flushed at the end. Returns false if the sink failed.
+//
+bool json_writer(json_output_t& out, const JsonValue& val);
+
+
+//
+// Writes a document without a tree: the values are written to 'out' as they're passed.
+// The calls must make a valid document: the objects have a key before each value and
+// each begin_ has its end_. The commas are written by the writer.
+//
+//    json_sax_writer_t w(out);
+//    w.begin_object();
+//    w.key("id");  w.value(int64_t(42));
+//    w.key("tags");  w.begin_array();  w.value("a");  w.end_array();
+//    w.end_object();
+//    out.flush();
+//
+class json_sax_writer_t {
+public:
+	explicit json_sax_writer_t(json_output_t& out) : _out(out), _comma(false) { }
+	
+	void begin_object() { _separator(); _out.push_back('{'); _comma = false; }
+	void end_object() { _out.push_back('}'); _comma = true; }
+	void begin_array() { _separator(); _out.push_back('['); _comma = false; }
+	void end_array() { _out.push_back(']'); _comma = true; }
+	
+	// The keys and the strings are escaped (UTF-8)
+	void key(const char * str, size_t len);
+	void key(const char * str) { key(str, strlen(str)); }
+	void key(const std::string& str) { key(str.data(), str.size()); }
+	
+	void value(const char * str, size_t len);
+	void value(const char * str) { value(str, strlen(str)); }
+	void value(const std::string& str) { value(str.data(), str.size()); }
+	void value(int64_t num);
+	void value(double num);		// infinity and NaN are written as null
+	void value(bool val);
+	void value(std::nullptr_t);
+	void value(const JsonValue& val);	// a tree in the document
+	
+private:
+	void _separator() {
+		if (_comma) _out.push_back(',');
+		_comma = true;
+	}
+	
+	json_output_t& _out;
+	bool _comma;	// a ',' before the next value or key
+};
+
 //
 // Converts a conforming JSON string to the corresponding tree.
 // Note: The returned string (pair::second) is the memory backing for all the string values in the JSON value.
 //       Copying the JSON value will decouple the new object from the original string.
+// The objects and arrays have their exact size (@see json_builder_t::build_exact).
 //
 // Preconditions:
 // - @see azp::parseJson
@@ -100,7 +254,86 @@ void json_writer(std::string& stm, const JsonValue& val);
 std::pair<JsonValue, std::string> json_reader(const std::string& stm);
 
 //
-// Sorts the JSON objects' members by key for improved search times.
+// Same as above without the copy of the document: 'stm' is moved to the returned string
+// and parsed in place.
+//
+std::pair<JsonValue, std::string> json_reader(std::string&& stm);
+
+//
+// Parses [first, last) in place: the buffer is modified (@see azp::parseJson) and is the
+// memory backing for the string values, the caller keeps it alive while the tree is used.
+//
+// Throws std::exception in case of error.
+//
+JsonValue json_reader(char * first, char * last);
+
+//
+// Parses [first, last) without modifying it, the buffer can be read-only memory. The
+// string values without escapes point into the buffer, which the caller keeps alive while
+// the tree is used; the strings with escapes are unescaped in the returned string.
+// Slower than the in place parse (@see stream_parser_t). Note: a 'char *' buffer selects
+// the in place parse above.
+//
+// Throws std::exception in case of error.
+//
+std::pair<JsonValue, std::string> json_reader(const char * first, const char * last);
+
+//
+// An entry of the tape recorded by json_builder_t::build_exact: the values in document
+// order (the keys before their values), without the ends of the objects and arrays.
+//
+struct json_tape_entry_t {
+	ParserTypes type;
+	uint32_t count;		// Object_begin, Array_begin: the number of fields or values
+						// Object_key, String_val: 1 if val.string.p is an offset in the unescaped strings
+	value_t val;		// Object_begin, Array_begin: val.integer is the index of the entry after the last value
+};
+
+//
+// Converts JSON documents to trees one after the other, like json_reader, but without
+// copying the document and keeping the parser stack from one document to the next.
+// The buffer is parsed in place and is the backing for the string values of the tree.
+// Used by the NDJSON reader (azp_ndjson.h), one per thread.
+//
+class json_builder_t {
+public:
+	json_builder_t() : _stack(_a), _tape(_a), _open(_a) { }
+	json_builder_t(const json_builder_t&) = delete;
+	json_builder_t& operator=(const json_builder_t&) = delete;
+	
+	// Returns false if [first, last) cannot be parsed, the error is in 'p' (@see azp::parseJson)
+	bool build(parser_t& p, char * first, char * last, JsonValue& out);
+	
+	// The objects and arrays of the tree are allocated with 'a'
+	bool build(parser_t& p, char * first, char * last, JsonValue& out, alloc_t& a);
+	
+	//
+	// Two passes: the parser records a tape of the values with the sizes of the objects and
+	// arrays, then the tree is built from the tape. The vectors are allocated once with
+	// their final size and the values are constructed in place: no growth and no moves.
+	// The tape is kept from one document to the next.
+	//
+	bool build_exact(parser_t& p, char * first, char * last, JsonValue& out);
+	bool build_exact(parser_t& p, char * first, char * last, JsonValue& out, alloc_t& a);
+	
+	//
+	// The same, but [first, last) isn't modified: the strings without escapes point into
+	// it, the strings with escapes are unescaped by the stream parser and appended to
+	// 'unescaped', which is the backing for them.
+	//
+	bool build_exact(stream_parser_t& p, const char * first, const char * last, JsonValue& out, std::string& unescaped);
+	bool build_exact(stream_parser_t& p, const char * first, const char * last, JsonValue& out, std::string& unescaped, alloc_t& a);
+	
+private:
+	alloc_t _a;
+	vector<JsonValue, alloc_t> _stack;
+	vector<json_tape_entry_t, alloc_t> _tape;
+	vector<uint32_t, alloc_t> _open;	// the objects and arrays being recorded, indexes in _tape
+};
+
+//
+// Sorts the JSON objects' members by key for improved search times, the objects are
+// marked sorted (JsonValue::sorted).
 //
 void optimize_for_search(JsonValue& root) noexcept;
 
@@ -148,18 +381,230 @@ struct JsonObjectField {
 
 
 
+//
+// A hash index of the fields of an object, for the large objects searched many times: it
+// doesn't need the fields to be sorted and a lookup is O(1).
+// The index is built on the first find, in O(n), for the objects with at least
+// 'min_fields' fields; the smaller objects are searched linearly. It's a table of 8 byte
+// slots, at most half full, with open addressing (linear probing): 32 bits of the hash of
+// the name and the position of the field. It's built again when the object's size or
+// storage changed.
+// Reordering the fields (optimize_for_search, a sort) invalidates the positions:
+// find sees a name which doesn't match and builds the index again. A renamed field isn't
+// seen, call invalidate() after renaming.
+// The object must outlive the index.
+//
+class JsonObjectIndex {
+public:
+	static const size_t min_fields = 16;
+	
+	explicit JsonObjectIndex(const JsonObject& obj) noexcept;
+	
+	// The value of the first field named 'key', or nullptr
+	const JsonValue * find(const char * key, size_t len);
+	const JsonValue * find(const std::string& key) { return find(key.data(), key.size()); }
+	
+	// The index is built again on the next find
+	void invalidate() noexcept { _start = nullptr; }
+	
+	// Bytes used by the table
+	size_t size() const { return _slots.size() * sizeof(uint64_t); }
+	
+private:
+	void build();
+	
+	const JsonObject * _obj;
+	const JsonObjectField * _start;		// of the object when the index was built
+	size_t _count;
+	std::vector<uint64_t> _slots;	// hash << 32 | position + 1, 0: empty
+};
+
+
+
+//
+// The arena of a JsonDocument: the vectors of the tree are allocated from growing chunks
+// (arena_alloc_t). The blocks freed when the vectors grow are reused for the next vectors
+// of the same size (size_class_alloc_t), most objects and arrays of a document have a
+// handful of elements.
+//
+class json_arena_t {
+public:
+	json_arena_t() = default;
+	json_arena_t(const json_arena_t&) = delete;
+	json_arena_t& operator=(const json_arena_t&) = delete;
+	
+	block_t alloc(size_t n) { return _a.alloc(n); }
+	void free(block_t b) { _a.free(b); }
+	
+	// Frees all the blocks, keeps the last chunk
+	void reset() noexcept {
+		_a.drop_free_lists();
+		_a._parent.reset();
+	}
+	
+	// Bytes taken from the heap
+	size_t size() const { return _a._parent.size(); }
+	
+private:
+	size_class_alloc_t<arena_alloc_t<default_alloc_t>, 4096> _a;
+};
+
+
+//
+// Memory mapping of a file, read-only or copy-on-write
+//
+class mapped_file_t {
+public:
+	mapped_file_t() noexcept;
+	~mapped_file_t();
+
+	mapped_file_t(const mapped_file_t&) = delete;
+	mapped_file_t& operator=(const mapped_file_t&) = delete;
+
+	//
+	// Returns false if the file cannot be opened or mapped, or if it isn't a regular file
+	// (a pipe, a device).
+	// copy_on_write: the mapping can be modified, the pages written are copied and the
+	// file isn't changed (MAP_PRIVATE); only these pages take memory of their own.
+	//
+#if defined(_MSC_VER)
+	bool open(const wchar_t * path, bool copy_on_write = false) noexcept;
+#else
+	bool open(const char * path, bool copy_on_write = false) noexcept;
+#endif
+
+	void close() noexcept;
+
+	const char * data() const { return _data; }
+	size_t size() const { return _size; }
+	
+	// nullptr unless the file was opened copy_on_write
+	char * writable_data() const { return _writable ? _data : nullptr; }
+
+private:
+	char * _data;
+	size_t _size;
+	bool _writable;
+};
+
+
+//
+// A tree and the memory behind it: the string values point into the document's copy of
+// the JSON text (or into the file mapped by json_read_file) and the objects and arrays are
+// allocated from the document's arena.
+// The tree is freed at once with the arena, the values are not visited: the cost doesn't
+// depend on the size of the tree. The document can be reused, json_reader keeps the
+// largest chunk of the arena.
+//
+// The tree can be modified, with these restrictions:
+// - the objects and arrays added to the tree are created with doc.allocator()
+// - the values don't own memory: JsonString values and names are not freed (leak), use
+//   String_view values pointing to memory which outlives the document
+// - copies of the objects and arrays (JsonValue copies) are allocated from the arena too,
+//   they must not outlive the document
+//
+class JsonDocument {
+public:
+	JsonDocument();
+	~JsonDocument();
+	
+	JsonDocument(const JsonDocument&) = delete;
+	JsonDocument& operator=(const JsonDocument&) = delete;
+	
+	JsonDocument(JsonDocument&& other) noexcept;
+	JsonDocument& operator=(JsonDocument&& other) noexcept;
+	
+	JsonValue& root() { return _root; }
+	const JsonValue& root() const { return _root; }
+	
+	// The allocator of the objects and arrays of the tree
+	alloc_t& allocator() { return _data->alloc; }
+	
+	// Frees the tree, keeps the memory for the next document
+	void clear() noexcept;
+	
+	// Bytes used by the arena
+	size_t arena_size() const { return _data->arena.size(); }
+	
+private:
+	friend void json_reader(const std::string& stm, JsonDocument& doc);
+	friend void json_reader(std::string&& stm, JsonDocument& doc);
+#if defined(_MSC_VER)
+	friend void json_read_file(const wchar_t * path, JsonDocument& doc);
+#else
+	friend void json_read_file(const char * path, JsonDocument& doc);
+#endif
+	
+	// parses [first, last) in place, the text of the document
+	void _parse(char * first, char * last);
+	
+	// at a fixed address, the vectors of the tree point to 'alloc'
+	struct data_t {
+		json_arena_t arena;
+		alloc_t alloc;
+		std::string text;
+		mapped_file_t file;		// the text, if it was mapped
+		
+		data_t() : alloc(&arena) { }
+	};
+	
+	std::unique_ptr<data_t> _data;
+	JsonValue _root;
+};
+
+//
+// Converts a conforming JSON string to the corresponding tree in 'doc', like json_reader
+// above; the previous tree of 'doc' is freed.
+//
+// Throws std::exception in case of error, 'doc' is empty then.
+//
+void json_reader(const std::string& stm, JsonDocument& doc);
+
+// The same, 'stm' is moved to the document and parsed in place
+void json_reader(std::string&& stm, JsonDocument& doc);
+
+//
+// Loads a JSON file in 'doc', like json_reader; the previous tree of 'doc' is freed.
+// A regular file is mapped copy-on-write and parsed in place: the document keeps the
+// mapping, the string values point into it. Only the pages of the strings with escapes,
+// which are unescaped in place, are copied (and the last page if the text ends with a
+// number); the numbers are converted from a copy and the other pages are shared with the
+// system's file cache. The other files (pipes, devices) are read to the document's text.
+//
+// Throws std::exception if the file cannot be read or parsed, 'doc' is empty then.
+//
+#if defined(_MSC_VER)
+void json_read_file(const wchar_t * path, JsonDocument& doc);
+JsonDocument json_read_file(const wchar_t * path);
+#else
+void json_read_file(const char * path, JsonDocument& doc);
+JsonDocument json_read_file(const char * path);
+#endif
+
+
+
 //
 // Inline implementation
 //
 
-inline JsonValue::JsonValue() noexcept : type(Empty) { }
+inline block_t json_alloc_t::alloc(size_t n) {
+	return arena ? arena->alloc(n) : block_t{ ::malloc(n), n };
+}
+
+inline void json_alloc_t::free(block_t b) {
+	if (arena) arena->free(b);
+	else ::free(b.p);
+}
+
+inline JsonValue::JsonValue() noexcept : type(Empty), sorted(false) { }
 
-inline JsonValue::JsonValue(const JsonValue& other) : type(Empty) {
+inline JsonValue::JsonValue(const JsonValue& other) : type(Empty), sorted(false) {
 	operator=(other);
 }
 
 inline JsonValue::JsonValue(JsonValue&& other) noexcept
 	: type(other.type)
+	, sorted(other.sorted)
 {
 	switch (other.type) {
 		case Object:
@@ -193,28 +638,32 @@ inline JsonValue::JsonValue(JsonValue&& other) noexcept
 	}
 }
 
-inline JsonValue::JsonValue(std::nullptr_t) noexcept : type(Empty) { }
+inline JsonValue::JsonValue(std::nullptr_t) noexcept : type(Empty), sorted(false) { }
 
 inline JsonValue::JsonValue(JsonObject obj) noexcept
 	: type(Object)
+	, sorted(false)
 {
 	new (&u.object) JsonObject(std::move(obj));
 }
 
 inline JsonValue::JsonValue(JsonArray arr) noexcept
 	: type(Array)
+	, sorted(false)
 {
 	new (&u.array) JsonArray(std::move(arr));
 }
 
 inline JsonValue::JsonValue(int64_t num) noexcept
 	: type(Number)
+	, sorted(false)
 {
 	new (&u.number) int64_t(num);
 }
 
 inline JsonValue::JsonValue(double num) noexcept
 	: type(Float_num)
+	, sorted(false)
 {
 	new (&u.float_num) double(num);
 }
@@ -225,23 +674,26 @@ inline void JsonValue::_initString(JsonString&& str) noexcept {
 
 inline JsonValue::JsonValue(JsonString str) noexcept
 	: type(String)
+	, sorted(false)
 {
 	_initString(std::move(str));
 }
 
 inline JsonValue::JsonValue(const char* str)
 	: type(String)
+	, sorted(false)
 {
 	_initString(JsonString(str));
 }
 
 inline JsonValue::JsonValue(const string_view_t& str) noexcept
 	: type(String_view)
+	, sorted(false)
 {
 	u.view = str;
 }
 
-inline JsonValue::JsonValue(bool val) noexcept : type(val ? Bool_true : Bool_false) { }
+inline JsonValue::JsonValue(bool val) noexcept : type(val ? Bool_true : Bool_false), sorted(false) { }
 
 //--------------------------
 
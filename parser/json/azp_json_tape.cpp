@@ -0,0 +1,170 @@
+#include <string.h>
+#include <algorithm>
+#include <exception>
+#include "azp_json_tape.h"
+
+
+namespace azp {
+
+
+// the number of fields or values saturates, size() counts them then
+static const uint64_t max_count = 0xFFFFFF;
+
+
+static inline uint64_t tapeEntry(JsonValue::ValueTypes type, uint64_t payload) {
+	return (uint64_t(type) << 56) | payload;
+}
+
+
+size_t JsonTapeRef::size() const {
+	auto count = (tape()[_i] >> 32) & max_count;
+	if (count < max_count) return size_t(count);
+
+	count = 0;
+	if (is_array()) for (auto it : values()) { (void)it; count++; }
+	else for (auto it : fields()) { (void)it; count++; }
+	return size_t(count);
+}
+
+
+double JsonTapeRef::get_double() const {
+	auto bits = tape()[_i+1];
+	if (type() == JsonValue::Number) return double(int64_t(bits));
+
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+
+JsonTapeRef JsonTapeRef::find(const char * key, size_t len) const {
+	for (auto f : fields()) {
+		if (f.name.len == len && memcmp(f.name.str, key, len) == 0) return f.value;
+	}
+	return JsonTapeRef();
+}
+
+
+JsonTapeRef JsonTapeRef::operator[](const char * key) const {
+	return find(key, strlen(key));
+}
+
+
+JsonTapeRef JsonTapeRef::at(size_t n) const {
+	for (auto v : values()) {
+		if (!n--) return v;
+	}
+	return JsonTapeRef();
+}
+
+
+void JsonTapeDocument::clear() noexcept {
+	_tape.clear();
+	_text.clear();
+}
+
+
+struct tape_doc_ctx_t {
+	struct open_t {
+		size_t index;		// of the Object or Array entry
+		uint64_t count;
+	};
+
+	std::vector<uint64_t>& tape;
+	std::vector<open_t> open;
+	const char * text;
+};
+
+
+static bool tape_callback(void* ctx, enum ParserTypes type, const value_t& value) noexcept {
+	auto& t = *(tape_doc_ctx_t *)ctx;
+	auto& tape = t.tape;
+
+	try {
+		if (type == Object_end || type == Array_end) {
+			// the index of the entry after the container is 32 bits
+			if (tape.size() > UINT32_MAX) return false;
+
+			auto& c = t.open.back();
+			tape[c.index] |= (std::min(c.count, max_count) << 32) | tape.size();
+			t.open.pop_back();
+			return true;
+		}
+
+		// the fields of the objects are counted by their keys
+		if (t.open.size()) {
+			auto& parent = t.open.back();
+			if ((type == Object_key) | ((tape[parent.index] >> 56) == JsonValue::Array)) parent.count++;
+		}
+
+		switch (type) {
+			case Object_begin:
+				t.open.push_back(tape_doc_ctx_t::open_t{ tape.size(), 0 });
+				tape.push_back(tapeEntry(JsonValue::Object, 0));
+				break;
+
+			case Array_begin:
+				t.open.push_back(tape_doc_ctx_t::open_t{ tape.size(), 0 });
+				tape.push_back(tapeEntry(JsonValue::Array, 0));
+				break;
+
+			case Object_key:
+			case String_val:
+				tape.push_back(tapeEntry(JsonValue::String_view, uint64_t(value.string.p - t.text)));
+				tape.push_back(uint64_t(value.string.len));
+				break;
+
+			case Number_int:
+				tape.push_back(tapeEntry(JsonValue::Number, 0));
+				tape.push_back(uint64_t(value.integer));
+				break;
+
+			case Number_float: {
+				uint64_t bits;
+				memcpy(&bits, &value.number, sizeof(bits));
+				tape.push_back(tapeEntry(JsonValue::Float_num, 0));
+				tape.push_back(bits);
+				break;
+			}
+
+			case Bool_true:
+				tape.push_back(tapeEntry(JsonValue::Bool_true, 0));
+				break;
+
+			case Bool_false:
+				tape.push_back(tapeEntry(JsonValue::Bool_false, 0));
+				break;
+
+			default: // case Null_val:
+				tape.push_back(tapeEntry(JsonValue::Empty, 0));
+		}
+	}
+	catch (std::exception&) {
+		return false;	// out of memory
+	}
+
+	return true;
+}
+
+
+void json_reader(const std::string& stm, JsonTapeDocument& doc) {
+	doc.clear();
+	if (stm.empty()) return;
+
+	auto& text = doc._text;
+	text = stm;
+
+	tape_doc_ctx_t ctx{ doc._tape, {}, text.data() };
+
+	parser_t p;
+	p.set_max_recursion(20);
+	p.set_callback(&tape_callback, &ctx);
+
+	if (!parseJson(p, &text[0], &text[0] + text.size())) {
+		doc.clear();
+		throw std::exception(/*"cannot parse"*/);
+	}
+}
+
+
+} // namespace azp
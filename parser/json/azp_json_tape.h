@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "azp_json.h"
+#include "azp_json_api.h"
+
+
+namespace azp {
+
+class JsonTapeDocument;
+
+
+//
+// A read-only document: the values in document order in a single array of 8 byte entries
+// (the tape), and the JSON text which the strings point into.
+//
+// An entry is the type (JsonValue::ValueTypes) in the 8 high bits and a payload:
+// - Object, Array: the number of fields or values in bits 32-55 (saturated), and the
+//   index of the entry after the last value in bits 0-31: a value is skipped in O(1)
+// - String_view: the offset of the string in the text, the next entry is its length
+// - Number, Float_num: the next entry is the value, int64_t or the bits of the double
+// - Empty (null), Bool_true, Bool_false: no payload
+// The ends of the objects and arrays are not recorded. The fields of an object are the
+// key (a String_view) followed by the value.
+//
+// A value takes 8 or 16 bytes, a JsonValue 40 and a field of a JsonObject 80.
+//
+
+
+//
+// A value of a JsonTapeDocument: a position in the tape, valid as long as the document
+// is not modified or moved. The default value is invalid, it's returned by find and at
+// when there's no such value.
+//
+class JsonTapeRef {
+public:
+	class array_iterator;
+	class object_iterator;
+
+	template <typename Iterator>
+	struct range_t {
+		Iterator first, last;
+		Iterator begin() const { return first; }
+		Iterator end() const { return last; }
+	};
+
+	JsonTapeRef() noexcept : _doc(nullptr), _i(0) { }
+	JsonTapeRef(const JsonTapeDocument * doc, size_t i) noexcept : _doc(doc), _i(i) { }
+
+	bool valid() const { return _doc != nullptr; }
+	explicit operator bool() const { return valid(); }
+
+	// Empty (null), Object, Array, String_view, Number, Float_num, Bool_true or Bool_false
+	JsonValue::ValueTypes type() const;
+
+	bool is_null() const { return type() == JsonValue::Empty; }
+	bool is_object() const { return type() == JsonValue::Object; }
+	bool is_array() const { return type() == JsonValue::Array; }
+	bool is_string() const { return type() == JsonValue::String_view; }
+	bool is_number() const { return type() == JsonValue::Number || type() == JsonValue::Float_num; }
+	bool is_bool() const { return type() == JsonValue::Bool_true || type() == JsonValue::Bool_false; }
+
+	//
+	// Preconditions: the value has the type
+	//
+	string_view_t get_string() const;
+	int64_t get_int() const;		// Number
+	double get_double() const;		// Number or Float_num
+	bool get_bool() const { return type() == JsonValue::Bool_true; }
+
+	// Number of fields of an object or values of an array
+	size_t size() const;
+
+	// The value of the first field named 'key' of an object, linear search
+	JsonTapeRef find(const char * key, size_t len) const;
+	JsonTapeRef find(const std::string& key) const { return find(key.data(), key.size()); }
+	JsonTapeRef operator[](const char * key) const;
+
+	// The value 'n' of an array, the values before it are skipped
+	JsonTapeRef at(size_t n) const;
+	JsonTapeRef operator[](size_t n) const { return at(n); }
+
+	// The values of an array, the fields of an object
+	range_t<array_iterator> values() const;
+	range_t<object_iterator> fields() const;
+
+	// Index of the value in the tape
+	size_t index() const { return _i; }
+
+private:
+	friend class JsonTapeDocument;
+
+	const uint64_t * tape() const;
+
+	// the index of the entry after the value
+	size_t skip() const;
+
+	const JsonTapeDocument * _doc;
+	size_t _i;
+};
+
+
+class JsonTapeRef::array_iterator {
+public:
+	array_iterator(const JsonTapeDocument * doc, size_t i) noexcept : _cur(doc, i) { }
+
+	JsonTapeRef operator*() const { return _cur; }
+	array_iterator& operator++() { _cur._i = _cur.skip(); return *this; }
+
+	bool operator==(const array_iterator& other) const { return _cur._i == other._cur._i; }
+	bool operator!=(const array_iterator& other) const { return _cur._i != other._cur._i; }
+
+private:
+	JsonTapeRef _cur;
+};
+
+
+class JsonTapeRef::object_iterator {
+public:
+	struct field_t {
+		string_view_t name;
+		JsonTapeRef value;
+	};
+
+	object_iterator(const JsonTapeDocument * doc, size_t i) noexcept : _key(doc, i) { }
+
+	field_t operator*() const { return field_t{ _key.get_string(), JsonTapeRef(_key._doc, _key._i + 2) }; }
+	object_iterator& operator++() { _key._i = JsonTapeRef(_key._doc, _key._i + 2).skip(); return *this; }
+
+	bool operator==(const object_iterator& other) const { return _key._i == other._key._i; }
+	bool operator!=(const object_iterator& other) const { return _key._i != other._key._i; }
+
+private:
+	JsonTapeRef _key;
+};
+
+
+class JsonTapeDocument {
+public:
+	JsonTapeDocument() noexcept { }
+
+	JsonTapeDocument(const JsonTapeDocument&) = delete;
+	JsonTapeDocument& operator=(const JsonTapeDocument&) = delete;
+
+	JsonTapeDocument(JsonTapeDocument&&) = default;
+	JsonTapeDocument& operator=(JsonTapeDocument&&) = default;
+
+	// Invalid if the document is empty
+	JsonTapeRef root() const { return _tape.empty() ? JsonTapeRef() : JsonTapeRef(this, 0); }
+
+	bool empty() const { return _tape.empty(); }
+
+	// Keeps the memory for the next document
+	void clear() noexcept;
+
+	// Bytes used by the tape
+	size_t tape_size() const { return _tape.size() * sizeof(uint64_t); }
+
+private:
+	friend class JsonTapeRef;
+	friend void json_reader(const std::string& stm, JsonTapeDocument& doc);
+
+	std::vector<uint64_t> _tape;
+	std::string _text;
+};
+
+//
+// Converts a conforming JSON string to a tape in 'doc'; the previous content of 'doc' is
+// freed.
+//
+// Throws std::exception in case of error, 'doc' is empty then.
+//
+void json_reader(const std::string& stm, JsonTapeDocument& doc);
+
+
+
+//
+// Inline implementation
+//
+
+inline const uint64_t * JsonTapeRef::tape() const {
+	return _doc->_tape.data();
+}
+
+inline JsonValue::ValueTypes JsonTapeRef::type() const {
+	return JsonValue::ValueTypes(tape()[_i] >> 56);
+}
+
+inline string_view_t JsonTapeRef::get_string() const {
+	auto t = tape();
+	return string_view_t{ _doc->_text.data() + (t[_i] & 0xFFFFFFFFFFFFFFull), size_t(t[_i+1]) };
+}
+
+inline int64_t JsonTapeRef::get_int() const {
+	return int64_t(tape()[_i+1]);
+}
+
+inline size_t JsonTapeRef::skip() const {
+	auto e = tape()[_i];
+	switch (JsonValue::ValueTypes(e >> 56)) {
+		case JsonValue::Object:
+		case JsonValue::Array:
+			return size_t(uint32_t(e));
+
+		case JsonValue::String_view:
+		case JsonValue::Number:
+		case JsonValue::Float_num:
+			return _i + 2;
+
+		default:
+			return _i + 1;
+	}
+}
+
+inline JsonTapeRef::range_t<JsonTapeRef::array_iterator> JsonTapeRef::values() const {
+	return range_t<array_iterator>{ array_iterator(_doc, _i + 1), array_iterator(_doc, skip()) };
+}
+
+inline JsonTapeRef::range_t<JsonTapeRef::object_iterator> JsonTapeRef::fields() const {
+	return range_t<object_iterator>{ object_iterator(_doc, _i + 1), object_iterator(_doc, skip()) };
+}
+
+
+} // namespace azp
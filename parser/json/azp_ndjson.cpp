@@ -0,0 +1,215 @@
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "azp_ndjson.h"
+
+
+namespace azp {
+
+
+uint32_t ndjson_threads(const ndjson_options_t& opt) {
+	if (opt.threads) return opt.threads;
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+//
+// Shared by the threads: the batches are taken in order with 'next'
+//
+struct ndjson_pool_t {
+	const char * first;
+	const char * last;
+	size_t batch_size;
+	size_t batches;
+	std::atomic<size_t> next;
+	std::atomic<bool> stop;		// a callback returned false or threw
+	bool stopped;				// a callback returned false
+	std::mutex mutex;
+	std::exception_ptr exception;
+};
+
+
+//
+// Per thread data, reused from one record to the next
+//
+struct ndjson_thread_t {
+	std::string buf;		// the record being parsed (parseJson modifies the buffer)
+	json_builder_t builder;
+	json_arena_t arena;		// the objects and arrays of 'value', reset after each record
+	alloc_t alloc;
+	JsonValue value;		// declared after the arena: if a callback throws, it's destroyed first
+	
+	ndjson_thread_t() : alloc(&arena) { }
+	
+	// the value is dropped without running the destructors of the tree, as JsonDocument::clear
+	void clear() noexcept {
+		new (&value) JsonValue();
+		arena.reset();
+	}
+};
+
+
+// returns the first record which begins at or after 'pos'
+static const char * recordStart(const ndjson_pool_t& pool, const char * pos) {
+	if (pos == pool.first) return pos;
+
+	auto nl = (const char *)memchr(pos-1, '\n', pool.last - pos + 1);
+	return nl ? nl + 1 : pool.last;
+}
+
+
+template <typename Worker>
+static void runBatches(ndjson_pool_t& pool, uint32_t thread, Worker& worker) {
+	try {
+		ndjson_thread_t data;
+
+		for (;;) {
+			auto batch = pool.next.fetch_add(1, std::memory_order_relaxed);
+			if (batch >= pool.batches) return;
+
+			auto offset = batch * pool.batch_size;
+			auto cur = recordStart(pool, pool.first + offset);
+			auto stop = recordStart(pool, pool.first + std::min(offset + pool.batch_size, size_t(pool.last - pool.first)));
+
+			while (cur < stop) {
+				if (pool.stop.load(std::memory_order_relaxed)) return;
+
+				auto nl = (const char *)memchr(cur, '\n', pool.last - cur);
+				auto end = nl ? nl : pool.last;
+
+				ndjson_record_t rec;
+				rec.first = cur;
+				rec.last = (end != cur && end[-1] == '\r') ? end - 1 : end;
+				rec.offset = cur - pool.first;
+				rec.thread = thread;
+
+				if (rec.first != rec.last && !worker(data, rec)) {
+					std::lock_guard<std::mutex> lock(pool.mutex);
+					pool.stopped = true;
+					pool.stop = true;
+					return;
+				}
+
+				cur = nl ? nl + 1 : pool.last;
+			}
+		}
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		if (!pool.exception) pool.exception = std::current_exception();
+		pool.stop = true;
+	}
+}
+
+
+template <typename Worker>
+static bool runPool(const char * first, const char * last, const ndjson_options_t& opt, Worker worker) {
+	ndjson_pool_t pool;
+	pool.first = first;
+	pool.last = last;
+	pool.batch_size = opt.batch_size ? opt.batch_size : ndjson_options_t().batch_size;
+	pool.batches = (size_t(last - first) + pool.batch_size - 1) / pool.batch_size;
+	pool.next = 0;
+	pool.stop = false;
+	pool.stopped = false;
+
+	auto count = std::min<size_t>(ndjson_threads(opt), std::max<size_t>(pool.batches, 1));
+
+	std::vector<std::thread> threads;
+	try {
+		for (uint32_t t=1; t<count; ++t) {
+			threads.emplace_back([&pool, &worker, t]() { runBatches(pool, t, worker); });
+		}
+	}
+	catch (...) {
+		pool.stop = true;
+		for (auto& th : threads) th.join();
+		throw;
+	}
+
+	// the calling thread is thread 0
+	runBatches(pool, 0, worker);
+
+	for (auto& th : threads) th.join();
+
+	if (pool.exception) std::rethrow_exception(pool.exception);
+	return !pool.stopped;
+}
+
+
+bool ndjson_parse(const char * first, const char * last,
+				  parser_callback_t callback, void * const * contexts,
+				  ndjson_record_callback_t done, void * done_ctx,
+				  const ndjson_options_t& opt)
+{
+	return runPool(first, last, opt, [&](ndjson_thread_t& data, const ndjson_record_t& rec) {
+		parser_t p;
+		p.set_max_recursion(opt.max_recursion);
+		p.set_callback(callback, contexts ? contexts[rec.thread] : nullptr);
+
+		data.buf.assign(rec.first, rec.last);
+		parseJson(p, &data.buf[0], &data.buf[0] + data.buf.size());
+
+		return done ? done(done_ctx, rec, p) : true;
+	});
+}
+
+
+bool ndjson_reader(const char * first, const char * last,
+				   ndjson_value_callback_t callback, void * context,
+				   ndjson_record_callback_t error,
+				   const ndjson_options_t& opt)
+{
+	return runPool(first, last, opt, [&](ndjson_thread_t& data, const ndjson_record_t& rec) {
+		parser_t p;
+		p.set_max_recursion(opt.max_recursion);
+
+		data.buf.assign(rec.first, rec.last);
+		bool result = data.builder.build_exact(p, &data.buf[0], &data.buf[0] + data.buf.size(), data.value, data.alloc)
+			? callback(context, rec, data.value)
+			: (error ? error(context, rec, p) : true);
+
+		data.clear();
+		return result;
+	});
+}
+
+
+#if defined(_MSC_VER)
+bool ndjson_parse_file(const wchar_t * path,
+#else
+bool ndjson_parse_file(const char * path,
+#endif
+					   parser_callback_t callback, void * const * contexts,
+					   ndjson_record_callback_t done, void * done_ctx,
+					   const ndjson_options_t& opt)
+{
+	mapped_file_t file;
+	if (!file.open(path)) throw std::exception(/*"cannot map file"*/);
+
+	return ndjson_parse(file.data(), file.data() + file.size(), callback, contexts, done, done_ctx, opt);
+}
+
+
+#if defined(_MSC_VER)
+bool ndjson_read_file(const wchar_t * path,
+#else
+bool ndjson_read_file(const char * path,
+#endif
+					  ndjson_value_callback_t callback, void * context,
+					  ndjson_record_callback_t error,
+					  const ndjson_options_t& opt)
+{
+	mapped_file_t file;
+	if (!file.open(path)) throw std::exception(/*"cannot map file"*/);
+
+	return ndjson_reader(file.data(), file.data() + file.size(), callback, context, error, opt);
+}
+
+
+} // namespace azp
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "azp_json.h"
+#include "azp_json_api.h"
+
+
+namespace azp {
+
+
+//
+// NDJSON (JSON Lines): one JSON value per line, the lines end with '\n' or "\r\n".
+//
+// The input is split in batches of whole records (about 'batch_size' bytes each) which
+// are parsed by a pool of threads. A record belongs to the batch in which it begins;
+// the threads find the first record of their batch by looking for the previous '\n'.
+// The JSON strings cannot contain a raw new line (it's a control char), so a '\n' always
+// ends a record in a valid document: no quote tracking is needed to split the input.
+//
+// Each thread copies its records to a buffer of its own and parses them there, the
+// buffer and the parser stacks are reused from one record to the next. The trees of
+// ndjson_reader are allocated from an arena of the thread, reset after each record.
+// The callbacks are called from the worker threads: the records of a batch in order,
+// the batches in any order. Empty lines are skipped.
+//
+// The functions return false if a callback returned false; the remaining records are
+// not processed. An exception thrown by a callback stops the threads and is rethrown.
+//
+
+struct ndjson_record_t {
+	const char * first;		// the record in the input, without the line end
+	const char * last;
+	size_t offset;			// offset of the record from the start of the input
+	uint32_t thread;		// index of the thread which parses the record, in [0, threads)
+};
+
+
+struct ndjson_options_t {
+	uint32_t threads;		// number of threads, 0: one per hardware thread
+	size_t batch_size;		// bytes of input given to a thread at a time
+	uint32_t max_recursion;	// @see parser_t::set_max_recursion
+
+	ndjson_options_t() : threads(0), batch_size(1 << 20), max_recursion(20) { }
+};
+
+
+//
+// Called after each record with the parser's result: p.get_error() is No_error if the
+// record is valid, the error position is relative to rec.first.
+// Return 'true' to continue and 'false' to stop.
+//
+typedef bool (* ndjson_record_callback_t)(void * context, const ndjson_record_t& rec, const parser_t& p);
+
+//
+// Called with the tree of each valid record; the string values point into a buffer which
+// is reused for the next record and the objects and arrays are allocated from an arena
+// which is reset after the callback. JsonValue copies of the objects and arrays use the
+// same arena: to keep a value, keep its scalars or its text (json_writer).
+// Return 'true' to continue and 'false' to stop.
+//
+typedef bool (* ndjson_value_callback_t)(void * context, const ndjson_record_t& rec, JsonValue& value);
+
+
+//
+// Event interface: the values of each record are reported to 'callback' as with parseJson,
+// with the context contexts[thread] (one per thread, so that the callbacks don't need to
+// synchronize), then 'done' is called with 'done_ctx' (if not nullptr). 'contexts' has
+// ndjson_threads(opt) entries, or is nullptr.
+//
+bool ndjson_parse(const char * first, const char * last,
+				  parser_callback_t callback, void * const * contexts,
+				  ndjson_record_callback_t done, void * done_ctx,
+				  const ndjson_options_t& opt = ndjson_options_t());
+
+//
+// DOM interface: each valid record is converted to a JsonValue and passed to 'callback',
+// the invalid records are passed to 'error' (it can be nullptr, then they're skipped).
+// Both are called with the same 'context' from all the threads at once: the callbacks
+// synchronize their accesses to it, or use the part of it for rec.thread.
+//
+bool ndjson_reader(const char * first, const char * last,
+				   ndjson_value_callback_t callback, void * context,
+				   ndjson_record_callback_t error = nullptr,
+				   const ndjson_options_t& opt = ndjson_options_t());
+
+//
+// Helper functions: map the file and call the functions above.
+// Throw std::exception if the file cannot be mapped.
+//
+#if defined(_MSC_VER)
+bool ndjson_parse_file(const wchar_t * path,
+#else
+bool ndjson_parse_file(const char * path,
+#endif
+					   parser_callback_t callback, void * const * contexts,
+					   ndjson_record_callback_t done, void * done_ctx,
+					   const ndjson_options_t& opt = ndjson_options_t());
+
+#if defined(_MSC_VER)
+bool ndjson_read_file(const wchar_t * path,
+#else
+bool ndjson_read_file(const char * path,
+#endif
+					  ndjson_value_callback_t callback, void * context,
+					  ndjson_record_callback_t error = nullptr,
+					  const ndjson_options_t& opt = ndjson_options_t());
+
+//
+// Number of threads used with the options 'opt'
+//
+uint32_t ndjson_threads(const ndjson_options_t& opt);
+
+
+} // namespace azp
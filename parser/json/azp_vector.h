@@ -70,10 +70,10 @@ bool operator==(const vector<T, Allocator>& l, const vector<T, Allocator>& r)
 
 template <typename T, typename Allocator>
 void vector<T, Allocator>::reserve(size_t requested) {
-	size_t cap = capacity();
-	if (requested < cap) return;
+	size_t old_cap = capacity();
+	if (requested <= old_cap) return;
 	
-	cap = cap * 3 / 2;
+	size_t cap = old_cap * 3 / 2;
 	if (requested < cap) requested = cap;
 	
 	auto b = _a.alloc(requested * sizeof(T));
@@ -86,7 +86,7 @@ void vector<T, Allocator>::reserve(size_t requested) {
 	}
 	
 	if (_start) {
-		_a.free({_start, cap*sizeof(T)});
+		_a.free({_start, old_cap*sizeof(T)});
 	}
 	
 	_start = (T*)b.p;
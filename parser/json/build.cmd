@@ -5,4 +5,5 @@ set L_FLAGS= /link /OPT:ICF
 
 cl.exe /c %C_FLAGS% azp_json.cpp
 cl.exe /c %C_FLAGS% azp_json_api.cpp
-cl.exe %C_FLAGS% test_azpj2.cpp %L_FLAGS% azp_json.obj azp_json_api.obj
+cl.exe /c %C_FLAGS% azp_json_tape.cpp
+cl.exe %C_FLAGS% test_azpj2.cpp %L_FLAGS% azp_json.obj azp_json_api.obj azp_json_tape.obj
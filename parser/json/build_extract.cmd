@@ -0,0 +1,7 @@
+@echo off
+set C_FLAGS= /std:c++17 /GFyLA /EHsc /Zi /O2 /Oi /guard:cf- /arch:AVX /MD /sdl- /W4 /nologo /D_CRT_SECURE_NO_WARNINGS /DNDEBUG
+set L_FLAGS= /link /OPT:ICF
+
+cl.exe /c %C_FLAGS% azp_json.cpp
+cl.exe /c %C_FLAGS% azp_json_api.cpp
+cl.exe %C_FLAGS% test_extract.cpp %L_FLAGS% azp_json.obj azp_json_api.obj
@@ -0,0 +1,4 @@
+@echo off
+set C_FLAGS= /std:c++17 /EHsc /O2 /W4 /nologo /D_CRT_SECURE_NO_WARNINGS /DNDEBUG
+
+cl.exe %C_FLAGS% gen_json.cpp
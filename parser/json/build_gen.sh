@@ -0,0 +1,3 @@
+#!/bin/bash
+
+clang++ -std=c++14 -O2 gen_json.cpp -o gen_json.out
@@ -0,0 +1,3 @@
+#!/bin/bash
+
+clang++ -std=c++17 -O2 -pthread -Wno-logical-op-parentheses test_ndjson.cpp azp_ndjson.cpp azp_json.cpp azp_json_api.cpp -o test_ndjson.out
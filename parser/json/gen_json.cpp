@@ -0,0 +1,249 @@
+//
+// Generates the JSON documents used by the benchmarks (test_azpj2, test_rj, ...)
+//
+//    gen_json strings strings.json
+//    gen_json ndjson events.ndjson 1000000
+//    gen_json numbers numbers.json
+//    gen_json wide wide.json 2000
+//
+// strings: an array of log records, mostly long string values with a few escapes
+// ndjson: one event per line (JSON Lines), a mix of numbers, short strings and arrays
+// numbers: an array of metrics samples, almost only numbers: doubles printed with 3 to 17
+//          significant digits (some with an exponent) and integers of every size
+// wide: an array of messages of 200 fields (numbers, strings, small objects and arrays),
+//       with an id, a user object and an array of items among them
+//
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <random>
+
+
+static const char words[][12] = {
+	"request", "handled", "user", "session", "timeout", "connection", "closed", "by", "peer",
+	"retrying", "in", "ms", "cache", "miss", "for", "key", "the", "server", "returned", "status",
+};
+
+static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+//
+// A sentence of 'n' words, about one in 16 is quoted or followed by a new line
+//
+static void appendMessage(std::string& out, int n, std::mt19937& g)
+{
+	auto x = std::uniform_int_distribution<int>(0, sizeof(words)/sizeof(words[0]) - 1);
+	auto esc = std::uniform_int_distribution<int>(0, 31);
+
+	for (int i=0; i<n; ++i) {
+		if (i) out += ' ';
+
+		auto r = esc(g);
+		if (r == 0) out += "\\\"";
+		out += words[x(g)];
+		if (r == 0) out += "\\\"";
+		if (r == 1) out += "\\n";
+	}
+}
+
+
+static void appendBase64(std::string& out, int n, std::mt19937& g)
+{
+	auto x = std::uniform_int_distribution<int>(0, 63);
+	for (int i=0; i<n; ++i) out += base64[x(g)];
+}
+
+
+static std::string genStrings(int records, std::mt19937& g)
+{
+	auto len = std::uniform_int_distribution<int>(4, 40);
+	std::string out = "[\n";
+
+	for (int i=0; i<records; ++i) {
+		if (i) out += ",\n";
+		out += "{\"level\":\"info\",\"logger\":\"com.example.server.RequestHandler\",\"message\":\"";
+		appendMessage(out, len(g), g);
+		out += "\",\"trace\":\"";
+		appendBase64(out, 8*len(g), g);
+		out += "\",\"path\":\"C:\\\\Program Files\\\\Server\\\\logs\\\\";
+		appendBase64(out, 12, g);
+		out += ".log\"}";
+	}
+
+	out += "\n]\n";
+	return out;
+}
+
+
+static std::string genNdjson(int records, std::mt19937& g)
+{
+	auto len = std::uniform_int_distribution<int>(2, 12);
+	auto num = std::uniform_int_distribution<int>(0, 999999);
+	std::string out;
+
+	for (int i=0; i<records; ++i) {
+		out += "{\"id\":" + std::to_string(i);
+		out += ",\"ts\":1700000000." + std::to_string(num(g));
+		out += ",\"user\":\"";
+		appendBase64(out, 10, g);
+		out += "\",\"event\":\"";
+		appendMessage(out, len(g), g);
+		out += "\",\"values\":[";
+		for (int j=len(g); j; --j) {
+			out += std::to_string(num(g) - 500000);
+			if (j > 1) out += ',';
+		}
+		out += "],\"ok\":";
+		out += (num(g) & 1) ? "true" : "false";
+		out += "}\n";
+	}
+
+	return out;
+}
+
+
+static void appendDouble(std::string& out, double d, int digits)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%.*g", digits, d);
+	out += buf;
+}
+
+
+static std::string genNumbers(int records, std::mt19937& g)
+{
+	auto digits = std::uniform_int_distribution<int>(3, 17);
+	auto unit = std::uniform_real_distribution<double>(0, 1);
+	auto scale = std::uniform_int_distribution<int>(-12, 12);
+	auto bits = std::uniform_int_distribution<int>(1, 62);
+	std::string out = "[\n";
+
+	for (int i=0; i<records; ++i) {
+		if (i) out += ",\n";
+		out += "{\"ts\":";
+		appendDouble(out, 1700000000 + i * 0.001, 17);
+		out += ",\"cpu\":[";
+		for (int j=0; j<8; ++j) {
+			if (j) out += ',';
+			appendDouble(out, 100 * unit(g), digits(g));
+		}
+		out += "],\"lat\":[";
+		for (int j=0; j<4; ++j) {
+			if (j) out += ',';
+			appendDouble(out, unit(g) * std::pow(10.0, scale(g)), 17);
+		}
+		out += "],\"bytes\":[";
+		for (int j=0; j<6; ++j) {
+			if (j) out += ',';
+			auto n = int64_t(std::uniform_int_distribution<uint64_t>(0, (uint64_t(1) << bits(g)) - 1)(g));
+			out += std::to_string((j & 1) ? -n : n);
+		}
+		out += "]}";
+	}
+
+	out += "\n]\n";
+	return out;
+}
+
+
+static std::string genWide(int records, std::mt19937& g)
+{
+	auto len = std::uniform_int_distribution<int>(2, 10);
+	auto num = std::uniform_int_distribution<int>(0, 999999);
+	auto unit = std::uniform_real_distribution<double>(0, 1);
+	std::string out = "[\n";
+	
+	for (int i=0; i<records; ++i) {
+		if (i) out += ",\n";
+		out += "{\"id\":" + std::to_string(i);
+		
+		for (int j=0; j<200; ++j) {
+			char name[8];
+			snprintf(name, sizeof(name), "f%03d", j);
+			out += ",\"";
+			out += name;
+			out += "\":";
+			
+			switch (j % 6) {
+				case 0: out += std::to_string(num(g)); break;
+				case 1: appendDouble(out, 1000 * unit(g), 8); break;
+				case 2: out += '"'; appendMessage(out, len(g), g); out += '"'; break;
+				case 3: out += (num(g) & 1) ? "true" : "false"; break;
+				case 4:
+					out += '[';
+					for (int k=0; k<4; ++k) out += (k ? "," : "") + std::to_string(num(g));
+					out += ']';
+					break;
+				default:
+					out += "{\"a\":" + std::to_string(num(g)) + ",\"b\":\"";
+					appendBase64(out, 12, g);
+					out += "\"}";
+			}
+			
+			if (j == 99) {
+				out += ",\"user\":{\"id\":" + std::to_string(num(g)) + ",\"name\":\"";
+				appendBase64(out, 10, g);
+				out += "\"}";
+			}
+			
+			if (j == 179) {
+				out += ",\"items\":[";
+				for (int k=0; k<3; ++k) {
+					out += k ? ",{\"sku\":\"" : "{\"sku\":\"";
+					appendBase64(out, 8, g);
+					out += "\",\"price\":";
+					appendDouble(out, 100 * unit(g), 5);
+					out += '}';
+				}
+				out += ']';
+			}
+		}
+		
+		out += '}';
+	}
+	
+	out += "\n]\n";
+	return out;
+}
+
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		printf("usage: gen_json strings|ndjson|numbers|wide <output file> [records]\n");
+		return 1;
+	}
+
+	int records = (argc > 3) ? atoi(argv[3]) : 20000;
+	std::mt19937 g(0xCC6699);
+	std::string doc;
+
+	if (strcmp(argv[1], "strings") == 0) {
+		doc = genStrings(records, g);
+	}
+	else if (strcmp(argv[1], "ndjson") == 0) {
+		doc = genNdjson(records, g);
+	}
+	else if (strcmp(argv[1], "numbers") == 0) {
+		doc = genNumbers(records, g);
+	}
+	else if (strcmp(argv[1], "wide") == 0) {
+		doc = genWide(records, g);
+	}
+	else {
+		printf("unknown document type  %s\n", argv[1]);
+		return 1;
+	}
+
+	auto f = fopen(argv[2], "wb");
+	if (!f) {
+		printf("cannot open file  %s\n", argv[2]);
+		return 1;
+	}
+
+	fwrite(doc.data(), 1, doc.size(), f);
+	fclose(f);
+	return 0;
+}
@@ -6,6 +6,10 @@
 
 #include "../../include/test_utils.h"
 #include "azp_json_api.h"
+#include "azp_json.h"
+#include "azp_json_tape.h"
+#include <charconv>
+#include <cmath>
 
 
 using namespace azp;
@@ -23,6 +27,68 @@ std::pair<JsonValue, std::string> parseJson(const std::string& doc) {
 }
 
 
+// the parser modifies the buffer, the copy is part of the time
+bool parseOnly(const std::string& doc) {
+	std::string buf = doc;
+	parser_t p;
+	p.set_max_recursion(64);
+	
+	return parseJson(p, &buf[0], &buf[0] + buf.size());
+}
+
+
+// the chunks are passed as they would come from a socket
+bool parseStream(const std::string& doc, size_t chunk_size) {
+	stream_parser_t p;
+	p.set_max_recursion(64);
+	
+	for (size_t pos = 0; pos < doc.size(); pos += chunk_size) {
+		auto n = std::min(chunk_size, doc.size() - pos);
+		if (!p.parse(doc.data() + pos, doc.data() + pos + n)) return false;
+	}
+	return p.finish();
+}
+
+
+// the tree in an arena, freed at once
+void parseDocument(const std::string& doc, JsonDocument& d) {
+	try { json_reader(doc, d); }
+	catch (std::exception& e) {
+		std::cout << "parse failure  " << e.what() << '\n';
+	}
+}
+
+
+// the tree built while parsing (vectors grown as needed) or from a tape (exact sizes)
+bool parseBuilder(const std::string& doc, json_builder_t& b, bool exact) {
+	std::string buf = doc;
+	parser_t p;
+	p.set_max_recursion(64);
+	JsonValue v;
+	
+	if (exact) return b.build_exact(p, &buf[0], &buf[0] + buf.size(), v);
+	return b.build(p, &buf[0], &buf[0] + buf.size(), v);
+}
+
+
+// the document isn't copied, only the strings with escapes
+void parseReadOnly(const std::string& doc) {
+	try { json_reader(doc.data(), doc.data() + doc.size()); }
+	catch (std::exception& e) {
+		std::cout << "parse failure  " << e.what() << '\n';
+	}
+}
+
+
+// the tape without the tree
+void parseTape(const std::string& doc, JsonTapeDocument& d) {
+	try { json_reader(doc, d); }
+	catch (std::exception& e) {
+		std::cout << "parse failure  " << e.what() << '\n';
+	}
+}
+
+
 std::string writeJson(const JsonValue& root) {
 	std::string stm;
 	json_writer(stm, root);
@@ -36,15 +102,229 @@ void check() {
 	json_writer(j, v);
 	auto p = json_reader(j);
 	
-	if (p.first.type == JsonValue::Float_num && p.first.u.float_num == v.u.float_num) {
-		printf("check ok\n");
+	bool ok = p.first.type == JsonValue::Float_num && p.first.u.float_num == v.u.float_num;
+	
+	// the shortest representation which reads back to the same double
+	const std::pair<double, const char *> numbers[] = {
+		{ 0.1, "0.1" }, { -0.0, "-0" }, { 1e23, "1e+23" }, { 5e-324, "5e-324" }, { 1e-5, "1e-5" },
+		{ 1.7976931348623157e308, "1.7976931348623157e+308" }, { 0.0001234, "0.0001234" },
+		{ 1e16, "10000000000000000" }, { 1.0 / 3, "0.3333333333333333" }, { 12345678.9, "12345678.9" },
+	};
+	for (auto& n : numbers) {
+		j.clear();
+		json_writer(j, JsonValue(n.first));
+		if (j != n.second) ok = false;
 	}
-	else {
-		printf("check failed\n");
+	
+	printf(ok ? "check ok\n" : "check failed\n");
+}
+
+
+//
+// Hash of the callbacks: the stream parser has to report the same values as parseJson,
+// whatever the chunk size
+//
+static bool hashEvent(void * ctx, ParserTypes type, const value_t& val) {
+	auto& h = *(uint64_t*)ctx;
+	auto add = [&h](const void * data, size_t len) {
+		for (size_t i=0; i<len; ++i) h = (h ^ ((const uint8_t*)data)[i]) * 0x100000001B3ull;
+	};
+	
+	add(&type, sizeof(type));
+	if (type == String_val || type == Object_key) add(val.string.p, val.string.len);
+	if (type == Number_int) add(&val.integer, sizeof(val.integer));
+	if (type == Number_float) add(&val.number, sizeof(val.number));
+	return true;
+}
+
+
+void checkStream(const std::string& doc) {
+	uint64_t expected = 0;
+	std::string buf = doc;
+	parser_t p;
+	p.set_max_recursion(64);
+	p.set_callback(hashEvent, &expected);
+	bool result = parseJson(p, &buf[0], &buf[0] + buf.size());
+	
+	for (size_t chunk_size : { size_t(1), size_t(7), size_t(4096) }) {
+		uint64_t h = 0;
+		stream_parser_t sp;
+		sp.set_max_recursion(64);
+		sp.set_callback(hashEvent, &h);
+		
+		bool ok = true;
+		for (size_t pos = 0; ok && pos < doc.size(); pos += chunk_size) {
+			auto n = std::min(chunk_size, doc.size() - pos);
+			ok = sp.parse(doc.data() + pos, doc.data() + pos + n);
+		}
+		if (ok) ok = sp.finish();
+		
+		if (ok != result || h != expected || sp.get_error() != p.get_error()) {
+			printf("stream check failed, chunk size %d\n", (int)chunk_size);
+			return;
+		}
+	}
+	printf("stream check ok\n");
+}
+
+
+// the tape has the same values as the tree, found with find and at too
+static bool sameValue(const JsonTapeRef& t, const JsonValue& v) {
+	if (t.type() != (v.type == JsonValue::String ? JsonValue::String_view : v.type)) return false;
+	
+	switch (v.type) {
+		case JsonValue::Object: {
+			if (t.size() != v.u.object.size()) return false;
+			
+			auto f = v.u.object.begin();
+			for (auto tf : t.fields()) {
+				if (tf.name.len != f->nameSize() || memcmp(tf.name.str, f->nameStr(), tf.name.len)) return false;
+				if (!sameValue(tf.value, f->value)) return false;
+				++f;
+			}
+			return !v.u.object.size() || t.find(v.u.object.begin()->nameStr(), v.u.object.begin()->nameSize()).index() == t.index() + 3;
+		}
+		
+		case JsonValue::Array: {
+			if (t.size() != v.u.array.size()) return false;
+			
+			size_t i = 0;
+			for (auto tv : t.values()) {
+				// at() skips the values before, only the first ones or the check is quadratic
+				if ((i < 16 && tv.index() != t.at(i).index()) || !sameValue(tv, v.u.array[i])) return false;
+				++i;
+			}
+			return !t.at(i).valid();
+		}
+		
+		case JsonValue::String_view:
+			return t.get_string().len == v.u.view.len && !memcmp(t.get_string().str, v.u.view.str, v.u.view.len);
+		
+		case JsonValue::String:
+			return t.get_string().len == v.u.string.size() && !memcmp(t.get_string().str, v.u.string.data(), v.u.string.size());
+		
+		case JsonValue::Number:
+			return t.get_int() == v.u.number;
+		
+		case JsonValue::Float_num:
+			return t.get_double() == v.u.float_num;
+		
+		default:
+			return true;
 	}
 }
 
 
+void checkTape(const std::string& doc) {
+	JsonTapeDocument t;
+	parseTape(doc, t);
+	
+	JsonDocument d;
+	parseDocument(doc, d);
+	
+	bool ok = t.root().valid() && sameValue(t.root(), d.root());
+	printf("tape document check %s  tape=%dKB arena=%dKB\n", ok ? "ok" : "failed",
+		(int)(t.tape_size() >> 10), (int)(d.arena_size() >> 10));
+}
+
+
+// the trees of the readers which don't copy the document are those of json_reader
+void checkZeroCopy(const std::string& doc) {
+	auto expected = writeJson(parseJson(doc).first);
+	const auto saved = doc;
+	bool ok = true;
+	
+	try {
+		auto ro = json_reader(doc.data(), doc.data() + doc.size());
+		ok &= writeJson(ro.first) == expected && doc == saved;
+		
+		auto moved = json_reader(std::string(doc));
+		ok &= writeJson(moved.first) == expected;
+		
+		std::string buf = doc;
+		ok &= writeJson(json_reader(&buf[0], &buf[0] + buf.size())) == expected;
+		
+		JsonDocument d;
+		json_reader(std::string(doc), d);
+		ok &= writeJson(d.root()) == expected;
+		
+		printf("zero copy check %s  unescaped=%dKB\n", ok ? "ok" : "failed", (int)(ro.second.size() >> 10));
+	}
+	catch (std::exception&) {
+		printf("zero copy check failed\n");
+	}
+}
+
+
+//
+// The parser converts the numbers itself (parseNumber), the values must be the same as
+// std::from_chars: random doubles printed with 1 to 17 digits, random digit strings with
+// more than 19 significant digits, integers and the limits of both ranges.
+// The numbers are at most 24 chars, the longest accepted by parseNumber.
+//
+static bool numberEvent(void * ctx, ParserTypes type, const value_t& val) {
+	*(value_t*)ctx = val;
+	return type == Number_int || type == Number_float;
+}
+
+
+void checkNumbers() {
+	std::vector<std::string> numbers = {
+		"0", "-0", "0.0", "-0.0", "1e0", "0e999", "1E-7", "9007199254740993", "9007199254740992.5",
+		"2.2250738585072011e-308", "2.2250738585072014e-308", "4.9e-324", "2.5e-324", "2.4e-324", "1e-400",
+		"1.7976931348623157e308", "1.7976931348623159e308", "1e309", "0.30000000000000004",
+		"9223372036854775807", "-9223372036854775808", "9223372036854775808", "-9223372036854775809",
+		"123456789012345678901234", "0.0000000000123456789012", "-1.234567890123456789e-9",
+	};
+	
+	std::mt19937_64 g(0xCC6699);
+	char buf[40];
+	for (int i=0; i<200000; ++i) {
+		uint64_t bits = g();
+		double d;
+		memcpy(&d, &bits, sizeof(d));
+		if (!std::isfinite(d)) continue;
+		
+		snprintf(buf, sizeof(buf), "%.*g", int(bits % 17) + 1, d);
+		numbers.push_back(buf);
+		
+		std::string digits(1, char('1' + g() % 9));
+		for (int j = int(g() % 24); j; --j) digits += char('0' + g() % 10);
+		std::string sign = (bits & 1) ? "-" : "";
+		numbers.push_back(sign + digits);
+		
+		auto exp = sign + "0." + digits + "e" + std::to_string(int(g() % 600) - 300);
+		if (exp.size() <= 24) numbers.push_back(exp);
+	}
+	
+	size_t errors = 0;
+	for (auto& n : numbers) {
+		value_t val;
+		std::string doc = n;
+		parser_t p;
+		p.set_callback(numberEvent, &val);
+		bool ok = parseJson(p, &doc[0], &doc[0] + doc.size());
+		
+		bool is_float = n.find_first_of(".eE") != std::string::npos;
+		bool same;
+		if (is_float) {
+			double d;
+			auto res = std::from_chars(n.data(), n.data() + n.size(), d);
+			same = (res.ec == std::errc()) ? ok && memcmp(&d, &val.number, sizeof(d)) == 0 : !ok;
+		}
+		else {
+			int64_t x;
+			auto res = std::from_chars(n.data(), n.data() + n.size(), x);
+			same = (res.ec == std::errc()) ? ok && x == val.integer : !ok;
+		}
+		
+		if (!same && errors++ < 10) printf("number check failed  %s\n", n.c_str());
+	}
+	
+	if (!errors) printf("number check ok\n");
+}
+
+
 #if defined(_MSC_VER)
 int wmain(int, PWSTR argv[])
 {
@@ -58,10 +338,41 @@ int main(int, char* argv[]) {
 #endif
 
 	check();
+	checkNumbers();
 	 
 	auto str = loadFile(argv[1]);
+	checkStream(str);
+	checkTape(str);
+	checkZeroCopy(str);
+	
+	{
+		JsonDocument d;
+		parseDocument(str, d);
+		parseDocument(str, d);	// reused
+		printf(writeJson(d.root()) == writeJson(parseJson(str).first) ? "document check ok\n" : "document check failed\n");
+	}
+	{
+		std::string b1 = str, b2 = str;
+		parser_t p;
+		json_builder_t b;
+		JsonValue v1, v2;
+		bool ok = b.build(p, &b1[0], &b1[0] + b1.size(), v1) && b.build_exact(p, &b2[0], &b2[0] + b2.size(), v2);
+		printf(ok && writeJson(v1) == writeJson(v2) ? "tape check ok\n" : "tape check failed\n");
+	}
 	
+	benchmark("Parser",         [&str](){parseOnly(str);});
+	benchmark("Parser stream",  [&str](){parseStream(str, 65536);});
+	json_builder_t builder;
+	benchmark("Builder grow",   [&str,&builder](){parseBuilder(str, builder, false);});
+	benchmark("Builder exact",  [&str,&builder](){parseBuilder(str, builder, true);});
 	benchmark("Json API load",  [&str](){parseJson(str);});
+	benchmark("Json API const", [&str](){parseReadOnly(str);});
+	benchmark("Json doc load",  [&str](){JsonDocument d; parseDocument(str, d);});
+	JsonDocument doc;
+	benchmark("Json doc reuse", [&str,&doc](){parseDocument(str, doc);});
+	benchmark("Tape doc load",  [&str](){JsonTapeDocument d; parseTape(str, d);});
+	JsonTapeDocument tape;
+	benchmark("Tape doc reuse", [&str,&tape](){parseTape(str, tape);});
 	auto root = parseJson(str); { auto b = root; root = std::move(b); }
 	// if (str != writeJson(root.first)) printf("problem\n");
 	// else printf("ok\n");
@@ -0,0 +1,303 @@
+//
+// Checks the on-demand extraction (extractJson) against the paths looked up in the tree of
+// json_reader, and compares the time to get a few fields out of wide objects with the
+// whole parse.
+//
+//    gen_json wide wide.json 2000
+//    test_extract wide.json
+//
+#if defined(_MSC_VER)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#endif // _MSC_VER
+
+#include "../../include/test_utils.h"
+#include "azp_json.h"
+#include "azp_json_api.h"
+
+
+using namespace azp;
+
+
+struct match_t {
+	uint32_t path;
+	std::string value;
+
+	bool operator<(const match_t& other) const {
+		return path != other.path ? path < other.path : value < other.value;
+	}
+	bool operator==(const match_t& other) const { return path == other.path && value == other.value; }
+};
+
+
+static std::string writeJson(const JsonValue& val) {
+	std::string stm;
+	json_writer(stm, val);
+	return stm;
+}
+
+
+// the values of both sides written the same way
+static std::string valueText(ParserTypes type, const value_t& val) {
+	switch (type) {
+		case Object_begin:
+		case Array_begin:
+			return writeJson(json_reader(std::string(val.string.p, val.string.len)).first);
+		case String_val: return writeJson(JsonValue(std::string(val.string.p, val.string.len)));
+		case Number_int: return writeJson(JsonValue(val.integer));
+		case Number_float: return writeJson(JsonValue(val.number));
+		case Bool_true: return "true";
+		case Bool_false: return "false";
+		default: return "null";
+	}
+}
+
+
+static bool addMatch(void * ctx, uint32_t path, ParserTypes type, const value_t& val) {
+	((std::vector<match_t> *)ctx)->push_back(match_t{ path, valueText(type, val) });
+	return true;
+}
+
+
+static std::vector<std::string> splitPath(const std::string& path) {
+	std::vector<std::string> keys;
+	if (path.empty()) return keys;
+
+	size_t pos = 1;
+	for (;;) {
+		auto end = std::min(path.find('/', pos), path.size());
+		std::string key;
+		for (auto i = pos; i < end; ++i) {
+			if (path[i] == '~' && i+1 < end && (path[i+1] == '0' || path[i+1] == '1')) key += (path[++i] == '0') ? '~' : '/';
+			else key += path[i];
+		}
+		keys.push_back(key);
+		if (end == path.size()) return keys;
+		pos = end + 1;
+	}
+}
+
+
+static void lookup(const JsonValue& val, const std::vector<std::string>& keys, size_t k, uint32_t path, std::vector<match_t>& out) {
+	if (k == keys.size()) {
+		out.push_back(match_t{ path, writeJson(val) });
+		return;
+	}
+
+	auto& key = keys[k];
+	if (val.type == JsonValue::Object) {
+		for (auto& f : val.u.object) {
+			if (key == "*" || key == std::string(f.nameStr(), f.nameSize())) lookup(f.value, keys, k+1, path, out);
+		}
+	}
+	else if (val.type == JsonValue::Array) {
+		bool index = !key.empty() && key.find_first_not_of("0123456789") == std::string::npos && (key[0] != '0' || key.size() == 1);
+		for (size_t i = 0; i < val.u.array.size(); ++i) {
+			if (key == "*" || (index && std::to_string(i) == key)) lookup(val.u.array[i], keys, k+1, path, out);
+		}
+	}
+}
+
+
+static bool check(const std::string& doc, const std::vector<std::string>& paths) {
+	json_paths_t jp;
+	for (auto& path : paths) jp.add(path);
+	bool wildcards = false;
+	for (auto& path : paths) wildcards |= path.find('*') != std::string::npos;
+
+	std::vector<match_t> expected;
+	auto root = json_reader(doc);
+	for (uint32_t i = 0; i < paths.size(); ++i) {
+		std::vector<match_t> found;
+		lookup(root.first, splitPath(paths[i]), 0, i, found);
+		if (!wildcards && found.size() > 1) found.resize(1);	// the first match
+		expected.insert(expected.end(), found.begin(), found.end());
+	}
+
+	std::vector<match_t> matches;
+	std::string buf = doc;
+	parser_t p;
+	p.set_max_recursion(64);
+	bool ok = extractJson(p, jp, &buf[0], &buf[0] + buf.size(), addMatch, &matches);
+
+	std::sort(expected.begin(), expected.end());
+	std::sort(matches.begin(), matches.end());
+
+	if (!ok || matches != expected) {
+		printf("extract check failed  %s\n", paths[0].c_str());
+		return false;
+	}
+	return true;
+}
+
+
+static bool checkError(const char * doc, const char * path) {
+	json_paths_t jp;
+	jp.add(path);
+
+	std::vector<match_t> matches;
+	std::string buf = doc;
+	parser_t p;
+	if (!extractJson(p, jp, &buf[0], &buf[0] + buf.size(), addMatch, &matches)) return true;
+
+	printf("extract error check failed  %s\n", doc);
+	return false;
+}
+
+
+static bool check(const std::string& wide) {
+	const std::string doc = "{\"a\":1,\"b\":{\"c\":\"x\\ny\",\"d\":[1,2.5,{\"e\":null}]},\"a/b\":true,\"t~\":false,"
+		"\"arr\":[[1,2],[3,4],[]],\"u\":\"\\u00e9\",\"k\\\"q\":[{\"}\":\"]\"}],\"a\":2}";
+
+	bool ok = check(doc, { "/a", "/b/c", "/b/d/2/e", "/a~1b", "/t~0", "/k\"q/0/}", "/missing", "/b/d/5", "/b/d/01" });
+	ok &= check(doc, { "/arr/*/1", "/b", "/b/d", "", "/u", "/*", "/a" });
+	ok &= check(doc, { "/b/*/*" });
+	ok &= check("[1,\"x\",[2]]", { "/0", "/2/0", "/1" });
+	ok &= check("\"top\"", { "" });
+
+	ok &= checkError("{\"a\":tru}", "/a");
+	ok &= checkError("{\"a\":1,", "/b");
+	ok &= checkError("{\"a\":[1,2", "/b");
+	ok &= checkError("{\"a\":\"x}", "/b");
+	ok &= checkError("{\"a\" 1}", "/a");
+
+	ok &= check(wide, { "/*/id", "/*/user/id", "/*/items/*/price", "/*/f150", "/*/f005/b" });
+	ok &= check(wide, { "/10/f002", "/3/items", "/0/user/name", "/100000/id" });
+
+	printf("extract check %s\n", ok ? "ok" : "failed");
+	return ok;
+}
+
+
+struct sum_t {
+	size_t values;
+	double sum;
+};
+
+
+static bool sumEvent(void * ctx, ParserTypes type, const value_t& val) {
+	auto& s = *(sum_t *)ctx;
+	s.values++;
+	if (type == Number_int) s.sum += double(val.integer);
+	if (type == Number_float) s.sum += val.number;
+	return true;
+}
+
+
+static bool sumMatch(void * ctx, uint32_t, ParserTypes type, const value_t& val) {
+	return sumEvent(ctx, type, val);
+}
+
+
+template <typename Fn>
+void throughput(const char * desc, size_t bytes, Fn fn) {
+	long long time = 0x7FFFFFFFFFFFFFFLL;
+	sum_t s = {};
+
+	for (int i=0; i<5; ++i) {
+		auto start = std::chrono::steady_clock::now();
+
+		s = fn();
+
+		auto end = std::chrono::steady_clock::now();
+		auto diff = std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+		if (time > diff) time = diff;
+	}
+
+	printf("%-22s %8dus  %6.2f GB/s  values=%d\n", desc, (int)(time/1000), bytes / double(time), (int)s.values);
+}
+
+
+static sum_t parseAll(const std::string& doc, int repeat) {
+	sum_t s = {};
+	for (int i=0; i<repeat; ++i) {
+		std::string buf = doc;
+		parser_t p;
+		p.set_max_recursion(64);
+		p.set_callback(sumEvent, &s);
+		parseJson(p, &buf[0], &buf[0] + buf.size());
+	}
+	return s;
+}
+
+
+static sum_t extract(const std::string& doc, const json_paths_t& paths, int repeat) {
+	sum_t s = {};
+	for (int i=0; i<repeat; ++i) {
+		std::string buf = doc;
+		parser_t p;
+		p.set_max_recursion(64);
+		extractJson(p, paths, &buf[0], &buf[0] + buf.size(), sumMatch, &s);
+	}
+	return s;
+}
+
+
+static bool keepRaw(void * ctx, uint32_t, ParserTypes, const value_t& val) {
+	((std::string *)ctx)->assign(val.string.p, val.string.len);
+	return true;
+}
+
+
+#if defined(_MSC_VER)
+int wmain(int, PWSTR argv[])
+{
+#else
+int main(int, char* argv[]) {
+#endif
+
+	auto doc = loadFile(argv[1]);
+	bool ok = check(doc);
+
+	//
+	// The whole document: 4 fields of each message
+	//
+	printf("\n");
+	throughput("parseJson", doc.size(), [&doc]() { return parseAll(doc, 1); });
+
+	throughput("json_reader + lookup", doc.size(), [&doc]() {
+		sum_t s = {};
+		auto root = json_reader(doc);
+		for (auto& m : root.first.u.array) {
+			for (auto& f : m.u.object) {
+				auto name = std::string(f.nameStr(), f.nameSize());
+				if (name == "id" || name == "f150") sumEvent(&s, Number_int, value_t{ f.value.u.number });
+				if (name == "user") sumEvent(&s, Number_int, value_t{ f.value.u.object[0].value.u.number });
+				if (name == "items") for (auto& it : f.value.u.array) sumEvent(&s, Number_int, value_t{ int64_t(it.u.object[1].value.u.float_num) });
+			}
+		}
+		return s;
+	});
+
+	json_paths_t paths;
+	for (auto path : { "/*/id", "/*/user/id", "/*/items/*/price", "/*/f150" }) paths.add(path);
+	throughput("extractJson", doc.size(), [&]() { return extract(doc, paths, 1); });
+
+	//
+	// One message at a time: the fields are found early (stop) or late
+	//
+	std::string message;
+	json_paths_t first;
+	first.add("/0");
+	std::string buf = doc;
+	parser_t p;
+	p.set_max_recursion(64);
+	extractJson(p, first, &buf[0], &buf[0] + buf.size(), keepRaw, &message);
+
+	const int repeat = 2000;
+	printf("\nmessage of %d bytes x %d\n", (int)message.size(), repeat);
+	throughput("parseJson", message.size() * repeat, [&]() { return parseAll(message, repeat); });
+
+	json_paths_t early;
+	early.add("/id");
+	early.add("/f001");
+	throughput("extractJson early", message.size() * repeat, [&]() { return extract(message, early, repeat); });
+
+	json_paths_t late;
+	late.add("/user/id");
+	late.add("/items/2/price");
+	throughput("extractJson late", message.size() * repeat, [&]() { return extract(message, late, repeat); });
+
+	printf("\n");
+	return ok ? 0 : 1;
+}
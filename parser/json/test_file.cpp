@@ -0,0 +1,108 @@
+//
+// Loads a JSON file the way it was done before json_read_file (the file read to a string,
+// then json_reader which copies it) or with json_read_file (the file mapped and parsed in
+// place), and prints the time and the peak memory of the process. One way per run: the
+// peak memory is that of the whole process.
+//
+//    gen_json strings big.json 2000000
+//    test_file check big.json
+//    test_file read big.json
+//    test_file map big.json
+//    cat big.json | test_file map /dev/stdin      (the pipe is read, not mapped)
+//
+// The hash of the tree (written back to JSON) is the same for all of them.
+//
+#if defined(_MSC_VER)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#include <psapi.h>
+#else
+	#include <sys/resource.h>
+#endif // _MSC_VER
+
+#include "../../include/test_utils.h"
+#include "azp_json_api.h"
+
+
+using namespace azp;
+
+
+static size_t peakMemory() {
+#if defined(_MSC_VER)
+	PROCESS_MEMORY_COUNTERS pmc;
+	GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+	return pmc.PeakWorkingSetSize;
+#else
+	struct rusage r;
+	getrusage(RUSAGE_SELF, &r);
+	return size_t(r.ru_maxrss) << 10;
+#endif
+}
+
+
+static uint64_t hashTree(const JsonValue& root) {
+	std::string stm;
+	json_writer(stm, root);
+
+	uint64_t h = 0xcbf29ce484222325ull;		// FNV-1a
+	for (auto c : stm) h = (h ^ uint8_t(c)) * 0x100000001b3ull;
+	return h;
+}
+
+
+#if defined(_MSC_VER)
+int wmain(int, PWSTR argv[])
+{
+	auto mode = std::wstring(argv[1]);
+	auto check = mode == L"check", read = mode == L"read";
+#else
+int main(int, char* argv[]) {
+	auto mode = std::string(argv[1]);
+	auto check = mode == "check", read = mode == "read";
+#endif
+
+	auto path = argv[2];
+
+	if (check) {
+		auto text = loadFile(path);
+		auto expected = hashTree(json_reader(text).first);
+
+		JsonDocument doc;
+		json_read_file(path, doc);
+		bool ok = hashTree(doc.root()) == expected;
+		json_read_file(path, doc);		// reused
+		ok &= hashTree(doc.root()) == expected;
+		doc.clear();
+
+		// copy-on-write: the file isn't modified
+		ok &= loadFile(path) == text;
+
+		printf("file check %s\n", ok ? "ok" : "failed");
+		return ok ? 0 : 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	// the tree is in the arena of the document with both, only the text differs
+	JsonDocument doc;
+	std::string text;
+	try {
+		if (read) {
+			text = loadFile(path);
+			json_reader(text, doc);		// copied
+		}
+		else json_read_file(path, doc);
+	}
+	catch (std::exception&) {
+		printf("cannot load the file\n");
+		return 1;
+	}
+
+	auto end = std::chrono::steady_clock::now();
+	auto time = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+	auto peak = peakMemory();
+
+	printf("%-5s %7dms  peak=%dMB  arena=%dMB  hash=%016llx\n", read ? "read" : "map", (int)time,
+		(int)(peak >> 20), (int)(doc.arena_size() >> 20), (unsigned long long)hashTree(doc.root()));
+	return 0;
+}
@@ -0,0 +1,156 @@
+//
+// Field lookups in objects of 4 to 16384 fields: linear search, binary search in the
+// objects sorted by optimize_for_search, and JsonObjectIndex. Checks that they find the
+// same fields and measures the time of a lookup, of the sort and of the index build.
+//
+//    test_find
+//
+#if defined(_MSC_VER)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#endif // _MSC_VER
+
+#include "../../include/test_utils.h"
+#include "azp_json_api.h"
+#include <set>
+
+
+using namespace azp;
+
+
+// config like names, distinct, with a common prefix
+static std::vector<std::string> genNames(int n, std::mt19937& g) {
+	std::vector<std::string> words;
+	gen_alphabet_string_array(n * 2, 4, 20, "abcdefghijklmnopqrstuvwxyz_", words, g);
+
+	std::set<std::string> seen;
+	std::vector<std::string> names;
+	for (auto& w : words) {
+		if ((int)names.size() == n) break;
+		if (seen.insert(w).second) names.push_back("service." + w);
+	}
+	return names;
+}
+
+
+// parsed like a document: the names are String_view fields
+static std::pair<JsonValue, std::string> makeObject(const std::vector<std::string>& names) {
+	std::string doc = "{";
+	for (size_t i = 0; i < names.size(); ++i) {
+		if (i) doc += ',';
+		doc += '"' + names[i] + "\":" + std::to_string(i);
+	}
+	doc += '}';
+	return json_reader(doc);
+}
+
+
+// the index of an object sorted, then of a renamed field
+static bool checkReorder(std::mt19937& g) {
+	auto names = genNames(40, g);
+	auto obj = makeObject(names);
+	auto& val = obj.first;
+
+	JsonObjectIndex index(val.u.object);
+	bool ok = index.find(names[0]) != nullptr;
+
+	// the fields are moved in place: the positions in the index are stale
+	optimize_for_search(val);
+	for (int i=0; i<40; ++i) {
+		auto v = index.find(names[i]);
+		ok &= v && v->u.number == i;
+	}
+
+	// renamed: seen after invalidate()
+	static const char renamed[] = "service.renamed";
+	auto& f = val.u.object[5];
+	auto number = f.value.u.number;
+	f.name.v = string_view_t{ renamed, sizeof(renamed) - 1 };
+	index.invalidate();
+	auto v = index.find(renamed);
+	ok &= v && v->u.number == number && !index.find(names[number]);
+
+	printf("reorder check %s\n", ok ? "ok" : "failed");
+	return ok;
+}
+
+
+template <typename Fn>
+long long minTime(int runs, Fn fn) {
+	long long time = 0x7FFFFFFFFFFFFFFLL;
+	for (int i=0; i<runs; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		auto end = std::chrono::steady_clock::now();
+		auto diff = std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+		if (time > diff) time = diff;
+	}
+	return time;
+}
+
+
+#if defined(_MSC_VER)
+int wmain(int, PWSTR [])
+{
+#else
+int main(int, char* []) {
+#endif
+
+	std::mt19937 g(0xCC6699);
+	const int lookups = 100000;
+	bool ok = checkReorder(g);
+
+	printf("%6s  %10s %10s %10s  %9s %9s %9s\n", "fields", "linear", "sorted", "hashed", "sort", "index", "index mem");
+
+	for (int n : { 4, 16, 64, 256, 1024, 4096, 16384 }) {
+		auto names = genNames(n, g);
+		auto obj = makeObject(names);
+		auto& val = obj.first;
+
+		// the keys looked up: one in 8 is missing
+		std::vector<std::string> keys;
+		auto pick = std::uniform_int_distribution<int>(0, n - 1);
+		for (int i=0; i<lookups; ++i) keys.push_back((i & 7) ? names[pick(g)] : "service.missing" + std::to_string(i));
+
+		int64_t expected = 0;
+		auto linear = minTime(3, [&]() {
+			int64_t sum = 0;
+			for (auto& k : keys) if (auto v = val.find(k)) sum += v->u.number + 1;
+			expected = sum;
+		});
+
+		auto sort = minTime(1, [&]() { optimize_for_search(val); });
+
+		int64_t sorted_sum = 0;
+		auto sorted = minTime(3, [&]() {
+			int64_t sum = 0;
+			for (auto& k : keys) if (auto v = val.find(k)) sum += v->u.number + 1;
+			sorted_sum = sum;
+		});
+
+		JsonObjectIndex index(val.u.object);
+		auto build = minTime(1, [&]() { index.find(names[0]); });
+
+		int64_t hashed_sum = 0;
+		auto hashed = minTime(3, [&]() {
+			int64_t sum = 0;
+			for (auto& k : keys) if (auto v = index.find(k)) sum += v->u.number + 1;
+			hashed_sum = sum;
+		});
+
+		// every name is found, at its value
+		for (int i=0; i<n; ++i) {
+			auto v = index.find(names[i]);
+			ok &= v && v->u.number == i && val.find(names[i]) == v;
+		}
+
+		ok &= (sorted_sum == expected) & (hashed_sum == expected);
+
+		printf("%6d  %8.1fns %8.1fns %8.1fns  %7.1fus %7.1fus %7dKB\n", n,
+			linear / double(lookups), sorted / double(lookups), hashed / double(lookups),
+			sort / 1000.0, build / 1000.0, (int)(index.size() >> 10));
+	}
+
+	printf("\nfind check %s\n", ok ? "ok" : "failed");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,263 @@
+//
+// Checks the NDJSON reader against a single threaded parse of each line and measures
+// the throughput (records/s and GB/s) with 1 to N threads.
+//
+//    gen_json ndjson events.ndjson 1000000
+//    test_ndjson events.ndjson
+//
+#if defined(_MSC_VER)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#endif // _MSC_VER
+
+#include "../../include/test_utils.h"
+#include "azp_ndjson.h"
+
+
+using namespace azp;
+
+
+//
+// Per thread results; the records are seen in any order, so the hashes are summed
+//
+struct alignas(64) thread_result_t {
+	size_t records;
+	size_t errors;
+	uint64_t sum;
+	uint64_t hash;		// of the record being parsed
+};
+
+
+static void hashBytes(uint64_t& h, const void * data, size_t len) {
+	for (size_t i=0; i<len; ++i) h = (h ^ ((const uint8_t*)data)[i]) * 0x100000001B3ull;
+}
+
+
+static bool hashEvent(void * ctx, ParserTypes type, const value_t& val) {
+	auto& h = ((thread_result_t*)ctx)->hash;
+
+	hashBytes(h, &type, sizeof(type));
+	if (type == String_val || type == Object_key) hashBytes(h, val.string.p, val.string.len);
+	if (type == Number_int) hashBytes(h, &val.integer, sizeof(val.integer));
+	if (type == Number_float) hashBytes(h, &val.number, sizeof(val.number));
+	return true;
+}
+
+
+static bool recordDone(void * ctx, const ndjson_record_t& rec, const parser_t& p) {
+	auto& r = ((thread_result_t*)ctx)[rec.thread];
+
+	r.records++;
+	if (p.get_error() != No_error) r.errors++;
+	r.sum += r.hash;
+	r.hash = 0;
+	return true;
+}
+
+
+static void hashValue(uint64_t& h, const JsonValue& val) {
+	hashBytes(h, &val.type, sizeof(val.type));
+
+	switch (val.type) {
+		case JsonValue::Object:
+			for (auto& f : val.u.object) {
+				hashBytes(h, f.nameStr(), f.nameSize());
+				hashValue(h, f.value);
+			}
+			break;
+
+		case JsonValue::Array:
+			for (auto& v : val.u.array) hashValue(h, v);
+			break;
+
+		case JsonValue::String:
+			hashBytes(h, val.u.string.data(), val.u.string.size());
+			break;
+
+		case JsonValue::String_view:
+			hashBytes(h, val.u.view.str, val.u.view.len);
+			break;
+
+		case JsonValue::Number:
+			hashBytes(h, &val.u.number, sizeof(val.u.number));
+			break;
+
+		case JsonValue::Float_num:
+			hashBytes(h, &val.u.float_num, sizeof(val.u.float_num));
+			break;
+
+		default: ;
+	}
+}
+
+
+static bool recordValue(void * ctx, const ndjson_record_t& rec, JsonValue& val) {
+	auto& r = ((thread_result_t*)ctx)[rec.thread];
+
+	uint64_t h = 0;
+	hashValue(h, val);
+	r.records++;
+	r.sum += h;
+	return true;
+}
+
+
+static bool recordError(void * ctx, const ndjson_record_t& rec, const parser_t&) {
+	auto& r = ((thread_result_t*)ctx)[rec.thread];
+
+	r.records++;
+	r.errors++;
+	return true;
+}
+
+
+static thread_result_t total(const std::vector<thread_result_t>& results) {
+	thread_result_t t = {};
+	for (auto& r : results) {
+		t.records += r.records;
+		t.errors += r.errors;
+		t.sum += r.sum;
+	}
+	return t;
+}
+
+
+static thread_result_t runEvents(const std::string& doc, const ndjson_options_t& opt) {
+	std::vector<thread_result_t> results(ndjson_threads(opt));
+	std::vector<void*> contexts;
+	for (auto& r : results) contexts.push_back(&r);
+
+	ndjson_parse(doc.data(), doc.data() + doc.size(), hashEvent, contexts.data(), recordDone, results.data(), opt);
+	return total(results);
+}
+
+
+static thread_result_t runValues(const std::string& doc, const ndjson_options_t& opt) {
+	std::vector<thread_result_t> results(ndjson_threads(opt));
+	ndjson_reader(doc.data(), doc.data() + doc.size(), recordValue, results.data(), recordError, opt);
+	return total(results);
+}
+
+
+//
+// The way it's done without the NDJSON reader: json_reader on a copy of each line
+//
+static thread_result_t runLines(const std::string& doc) {
+	thread_result_t t = {};
+	size_t pos = 0;
+
+	while (pos < doc.size()) {
+		auto nl = doc.find('\n', pos);
+		if (nl == std::string::npos) nl = doc.size();
+
+		auto line = doc.substr(pos, nl - pos);
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		pos = nl + 1;
+		if (line.empty()) continue;
+
+		t.records++;
+		try {
+			auto val = json_reader(line);
+			uint64_t h = 0;
+			hashValue(h, val.first);
+			t.sum += h;
+		}
+		catch (std::exception&) {
+			t.errors++;
+		}
+	}
+
+	return t;
+}
+
+
+//
+// The results don't depend on the number of threads and on where the batches end
+//
+static bool check(const std::string& doc) {
+	auto expected = runLines(doc);
+
+	ndjson_options_t one;
+	one.threads = 1;
+	auto events = runEvents(doc, one);
+	bool ok = (events.records == expected.records) & (events.errors == expected.errors);
+
+	for (uint32_t threads : { 1u, 3u, 8u }) {
+		for (size_t batch : { size_t(1), size_t(100), size_t(4096), size_t(1) << 20 }) {
+			ndjson_options_t opt;
+			opt.threads = threads;
+			opt.batch_size = batch;
+
+			auto e = runEvents(doc, opt);
+			auto v = runValues(doc, opt);
+
+			if (e.records != events.records || e.errors != events.errors || e.sum != events.sum ||
+				v.records != expected.records || v.errors != expected.errors || v.sum != expected.sum) {
+				printf("check failed  threads=%d batch=%d\n", (int)threads, (int)batch);
+				ok = false;
+			}
+		}
+	}
+
+	printf("check %s  records=%d errors=%d\n", ok ? "ok" : "failed", (int)expected.records, (int)expected.errors);
+	return ok;
+}
+
+
+template <typename Fn>
+void throughput(const char * desc, uint32_t threads, const std::string& doc, Fn fn) {
+	long long time = 0x7FFFFFFFFFFFFFFLL;
+	thread_result_t r = {};
+
+	for (int i=0; i<5; ++i) {
+		auto start = std::chrono::steady_clock::now();
+
+		r = fn();
+
+		auto end = std::chrono::steady_clock::now();
+		auto diff = std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+		if (time > diff) time = diff;
+	}
+
+	printf("%-12s threads=%2d  %8dus  %10.0f records/s  %6.2f GB/s\n", desc, (int)threads, (int)(time/1000),
+		r.records * 1e9 / time, doc.size() / double(time));
+}
+
+
+#if defined(_MSC_VER)
+int wmain(int, PWSTR argv[])
+{
+#else
+int main(int, char* argv[]) {
+#endif
+
+	auto doc = loadFile(argv[1]);
+	bool ok = check(doc + "{\"broken\":\n\n[1,2]\r\n\"text\"\n{\"x\": \"\\u12\"}\n\r\n  null  ");
+
+	printf("\n");
+	throughput("json_reader", 1, doc, [&doc]() { return runLines(doc); });
+
+	auto max_threads = ndjson_threads(ndjson_options_t());
+	for (uint32_t threads = 1; ; threads = std::min(threads * 2, max_threads)) {
+		ndjson_options_t opt;
+		opt.threads = threads;
+
+		throughput("events", threads, doc, [&doc, &opt]() { return runEvents(doc, opt); });
+		throughput("values", threads, doc, [&doc, &opt]() { return runValues(doc, opt); });
+
+		if (threads == max_threads) break;
+	}
+
+	//
+	// From the file, memory mapped
+	//
+	ndjson_options_t opt;
+	std::vector<thread_result_t> results(ndjson_threads(opt));
+	throughput("mapped file", ndjson_threads(opt), doc, [&]() {
+		for (auto& r : results) r = thread_result_t();
+		ndjson_read_file(argv[1], recordValue, results.data(), recordError, opt);
+		return total(results);
+	});
+
+	return ok ? 0 : 1;
+}
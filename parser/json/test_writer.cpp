@@ -0,0 +1,300 @@
+//
+// Checks the streaming writers (json_output_t, json_sax_writer_t) against json_writer to a
+// string, and compares the time and the memory taken to write a document to a file: the
+// text in a string then written, or streamed through the buffer of json_output_t.
+//
+//    test_writer check tele.json
+//    test_writer string tele.json
+//    test_writer stream tele.json
+//    test_writer sax tele.json
+//
+// The check also compares the escaping of the strings with a char by char version. The
+// strings are copied 16 chars at a time up to the first char to escape: compare the
+// writers on documents with long strings (gen_json strings big.json 2000000).
+//
+// The memory is the growth of the process while the document is written (the tree is
+// loaded before), one way per run.
+//
+#if defined(_MSC_VER)
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+	#include <psapi.h>
+	#include <io.h>
+	#define fileno _fileno
+	static const char null_device[] = "NUL";
+#else
+	#include <unistd.h>
+	static const char null_device[] = "/dev/null";
+#endif // _MSC_VER
+
+#include "../../include/test_utils.h"
+#include "azp_json_api.h"
+
+
+using namespace azp;
+
+
+static size_t currentMemory() {
+#if defined(_MSC_VER)
+	PROCESS_MEMORY_COUNTERS pmc;
+	GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+	return pmc.WorkingSetSize;
+#else
+	long pages = 0, resident = 0;
+	auto f = fopen("/proc/self/statm", "r");
+	if (f) {
+		if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+		fclose(f);
+	}
+	return size_t(resident) * size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+
+// the tree written again with the SAX writer
+static void writeSax(json_sax_writer_t& w, const JsonValue& val) {
+	switch (val.type) {
+		case JsonValue::Object:
+			w.begin_object();
+			for (auto& f : val.u.object) {
+				w.key(f.nameStr(), f.nameSize());
+				writeSax(w, f.value);
+			}
+			w.end_object();
+			break;
+
+		case JsonValue::Array:
+			w.begin_array();
+			for (auto& v : val.u.array) writeSax(w, v);
+			w.end_array();
+			break;
+
+		case JsonValue::String: w.value(val.u.string); break;
+		case JsonValue::String_view: w.value(val.u.view.str, val.u.view.len); break;
+		case JsonValue::Number: w.value(val.u.number); break;
+		case JsonValue::Float_num: w.value(val.u.float_num); break;
+		case JsonValue::Bool_true: w.value(true); break;
+		case JsonValue::Bool_false: w.value(false); break;
+		default: w.value(nullptr);
+	}
+}
+
+
+struct capture_t {
+	std::string text;
+	size_t limit;		// the sink fails past this size
+};
+
+
+static bool captureSink(void * ctx, const char * data, size_t size) {
+	auto& c = *(capture_t *)ctx;
+	if (c.text.size() + size > c.limit) return false;
+	c.text.append(data, size);
+	return true;
+}
+
+
+static std::string readBack(FILE * f) {
+	fflush(f);
+	rewind(f);
+	std::string text;
+	char buf[4096];
+	while (auto n = fread(buf, 1, sizeof(buf), f)) text.append(buf, n);
+	return text;
+}
+
+
+// the escaping of the writers, a char at a time
+static std::string escapeScalar(const std::string& s) {
+	static const char hex[] = "0123456789abcdef";
+	std::string r = "\"";
+	for (auto c : s) {
+		if (c == '"' || c == '\\') { r += '\\';  r += c; }
+		else if ((uint8_t)c < 0x20) { r += "\\u00";  r += hex[c >> 4];  r += hex[c & 15]; }
+		else r += c;
+	}
+	return r + '"';
+}
+
+
+// the strings written with the vector scan (16 chars and more) and without
+static bool checkEscape() {
+	std::vector<std::string> strings;
+	uint32_t seed = 12345;
+	auto rand = [&seed]() { seed = seed * 1103515245 + 12345;  return seed >> 8; };
+
+	// one char to escape (or 0x7F, 0x80, 0xFF which aren't) at every offset
+	for (int ch : { int('"'), int('\\'), 0, 0x0A, 0x1F, 0x20, 0x7F, 0x80, 0xFF }) {
+		for (size_t len = 1; len <= 80; ++len) {
+			for (size_t i = 0; i < len; ++i) {
+				std::string s(len, 'a');
+				s[i] = char(ch);
+				strings.push_back(s);
+			}
+		}
+	}
+	// all the byte values, sparse and dense escapes
+	for (size_t len = 0; len <= 100; ++len) {
+		for (int k = 0; k < 20; ++k) {
+			std::string s;
+			for (size_t i = 0; i < len; ++i) {
+				auto r = rand();
+				s += (r & 7) == 0 || k < 5 ? char(r >> 8) : char('a' + (r >> 8) % 26);
+			}
+			strings.push_back(s);
+		}
+	}
+
+	bool ok = true;
+	for (auto& s : strings) {
+		auto expected = escapeScalar(s);
+		JsonValue val(string_view_t{ s.data(), s.size() });
+
+		std::string stm;
+		json_writer(stm, val);
+		ok &= stm == expected;
+
+		capture_t c{ std::string(), SIZE_MAX };
+		{
+			json_output_t out(captureSink, &c, 16);
+			json_sax_writer_t w(out);
+			w.value(s.data(), s.size());
+		}
+		ok &= c.text == expected;
+	}
+
+	printf("escape check %s (%d strings)\n", ok ? "ok" : "failed", (int)strings.size());
+	return ok;
+}
+
+
+static bool check(const JsonValue& root) {
+	bool ok = checkEscape();
+	std::string expected;
+	json_writer(expected, root);
+
+	for (size_t buffer_size : { 1, 64, 100, 4096, 65536 }) {
+		capture_t c{ std::string(), SIZE_MAX };
+		{
+			json_output_t out(captureSink, &c, buffer_size);
+			ok &= json_writer(out, root) && out.size() == expected.size();
+		}
+		ok &= c.text == expected;
+
+		capture_t s{ std::string(), SIZE_MAX };
+		{
+			json_output_t out(captureSink, &s, buffer_size);
+			json_sax_writer_t w(out);
+			writeSax(w, root);
+		}	// flushed by the destructor
+		ok &= s.text == expected;
+	}
+
+	// the sink fails: the writer reports it and doesn't call the sink again
+	capture_t f{ std::string(), expected.size() / 2 };
+	{
+		json_output_t out(captureSink, &f, 4096);
+		ok &= !json_writer(out, root) && out.failed();
+	}
+	ok &= f.text.size() <= expected.size() / 2;
+
+	// FILE * and file descriptor
+	if (auto tmp = tmpfile()) {
+		{
+			json_output_t out(json_file_sink, tmp);
+			ok &= json_writer(out, root);
+		}
+		ok &= readBack(tmp) == expected;
+		fclose(tmp);
+	}
+	if (auto tmp = tmpfile()) {
+		{
+			json_output_t out(json_fd_sink, (void *)(intptr_t)fileno(tmp));
+			ok &= json_writer(out, root);
+		}
+		ok &= readBack(tmp) == expected;
+		fclose(tmp);
+	}
+
+	// the SAX writer, all the values
+	capture_t sax{ std::string(), SIZE_MAX };
+	{
+		json_output_t out(captureSink, &sax, 16);
+		json_sax_writer_t w(out);
+		w.begin_array();
+		w.begin_object();
+		w.key("a\"b");  w.value("x\ny");
+		w.key("n");  w.value(int64_t(-42));
+		w.key("d");  w.value(0.1);
+		w.key("e");  w.begin_array();  w.end_array();
+		w.key("o");  w.begin_object();  w.end_object();
+		w.end_object();
+		w.value(true);  w.value(false);  w.value(nullptr);
+		w.value(json_reader(std::string("{\"k\":[1,2]}")).first);
+		w.end_array();
+		ok &= out.flush();
+	}
+	ok &= sax.text == "[{\"a\\\"b\":\"x\\u000ay\",\"n\":-42,\"d\":0.1,\"e\":[],\"o\":{}},true,false,null,{\"k\":[1,2]}]";
+
+	printf("writer check %s\n", ok ? "ok" : "failed");
+	return ok;
+}
+
+
+#if defined(_MSC_VER)
+int wmain(int, PWSTR argv[])
+{
+	auto mode = std::wstring(argv[1]);
+	auto check_mode = mode == L"check", string_mode = mode == L"string", sax_mode = mode == L"sax";
+#else
+int main(int, char* argv[]) {
+	auto mode = std::string(argv[1]);
+	auto check_mode = mode == "check", string_mode = mode == "string", sax_mode = mode == "sax";
+#endif
+
+	JsonDocument doc;
+	try { json_read_file(argv[2], doc); }
+	catch (std::exception&) {
+		printf("cannot load the file\n");
+		return 1;
+	}
+
+	if (check_mode) return check(doc.root()) ? 0 : 1;
+
+	auto null = fopen(null_device, "wb");
+	auto before = currentMemory();
+	size_t extra = 0, size = 0;
+	long long time = 0x7FFFFFFFFFFFFFFLL;
+
+	for (int i=0; i<5; ++i) {
+		auto start = std::chrono::steady_clock::now();
+
+		if (string_mode) {
+			std::string stm;
+			json_writer(stm, doc.root());
+			fwrite(stm.data(), 1, stm.size(), null);
+			extra = std::max(extra, currentMemory() - before);
+			size = stm.size();
+		}
+		else {
+			json_output_t out(json_file_sink, null);
+			if (sax_mode) {
+				json_sax_writer_t w(out);
+				writeSax(w, doc.root());
+			}
+			else json_writer(out, doc.root());
+			out.flush();
+			extra = std::max(extra, currentMemory() - before);
+			size = out.size();
+		}
+
+		auto end = std::chrono::steady_clock::now();
+		auto diff = std::chrono::duration_cast<std::chrono::nanoseconds>(end-start).count();
+		if (time > diff) time = diff;
+	}
+
+	fclose(null);
+	printf("%-6s %8dus  %6.2f GB/s  memory +%dKB  size=%dKB\n", string_mode ? "string" : sax_mode ? "sax" : "stream",
+		(int)(time/1000), size / double(time), (int)(extra >> 10), (int)(size >> 10));
+	return 0;
+}